@@ -0,0 +1,423 @@
+
+#include <algorithm>
+#include <cstdio>
+
+#include <chrono.hpp>
+#include <fs.hpp>
+#include <printer.hpp>
+#include <sys.hpp>
+#include <test/Test.hpp>
+#include <var.hpp>
+
+#if defined __link
+
+#include <usb/usb_link_transport_driver.h>
+
+#include "FakeTransport.hpp"
+#include "ShapedPhy.hpp"
+#include "sos.hpp"
+
+// throughput and latency percentiles of a series of transfers
+class BenchReport {
+public:
+  BenchReport(
+    var::Vector<u32> sample_list,
+    u32 size,
+    chrono::MicroTime duration)
+    : m_sample_list(std::move(sample_list)), m_size(size),
+      m_duration(duration) {
+    std::sort(m_sample_list.begin(), m_sample_list.end());
+  }
+
+  API_NO_DISCARD u32 count() const { return m_sample_list.count(); }
+  API_NO_DISCARD u32 size() const { return m_size; }
+
+  API_NO_DISCARD u32 bytes_per_second() const {
+    const u64 microseconds = m_duration.microseconds();
+    return microseconds ? u32(u64(m_size) * 1000000 / microseconds) : 0;
+  }
+
+  API_NO_DISCARD u32 percentile(u32 value) const {
+    if (m_sample_list.count() == 0) {
+      return 0;
+    }
+    const u32 offset = (m_sample_list.count() - 1) * value / 100;
+    return m_sample_list.at(offset);
+  }
+
+private:
+  var::Vector<u32> m_sample_list;
+  u32 m_size;
+  chrono::MicroTime m_duration;
+};
+
+namespace printer {
+inline Printer &operator<<(Printer &printer, const BenchReport &a) {
+  return printer.key("count", var::NumberString(a.count()))
+    .key("size", var::NumberString(a.size()))
+    .key("bytesPerSecond", var::NumberString(a.bytes_per_second()))
+    .key("p50Microseconds", var::NumberString(a.percentile(50)))
+    .key("p90Microseconds", var::NumberString(a.percentile(90)))
+    .key("p99Microseconds", var::NumberString(a.percentile(99)))
+    .key("maxMicroseconds", var::NumberString(a.percentile(100)));
+}
+} // namespace printer
+
+/*
+ * Times the interval between progress updates. Operations that
+ * report progress after each transfer (update_os() and
+ * Appfs::append()) are timed per transfer without changing them.
+ *
+ * Only the first phase that reports increasing progress is
+ * sampled (for example, writing but not verifying).
+ */
+class ProgressTimer {
+public:
+  ProgressTimer() {
+    m_progress_callback.set_callback(update).set_context(this);
+    m_timer.start();
+  }
+
+  API_NO_DISCARD const api::ProgressCallback *progress_callback() const {
+    return &m_progress_callback;
+  }
+
+  API_NO_DISCARD const var::Vector<u32> &sample_list() const {
+    return m_sample_list;
+  }
+
+private:
+  api::ProgressCallback m_progress_callback;
+  chrono::ClockTimer m_timer;
+  var::Vector<u32> m_sample_list;
+  int m_progress = 0;
+  bool m_is_done = false;
+
+  static bool update(void *context, int progress, int total) {
+    auto *self = reinterpret_cast<ProgressTimer *>(context);
+    const bool is_transfer
+      = total > 0
+        && total != api::ProgressCallback::indeterminate_progress_total()
+        && progress > self->m_progress;
+
+    if (is_transfer && self->m_is_done == false) {
+      self->m_sample_list.push_back(
+        u32(self->m_timer.micro_time().microseconds()));
+      self->m_progress = progress;
+    } else if (self->m_progress > 0) {
+      self->m_is_done = true;
+    }
+
+    self->m_timer.restart();
+    return false;
+  }
+};
+
+/*
+ * Measures Link transfer throughput and latency.
+ *
+ * Options:
+ * - `--latency=<microseconds>` added to each phy write
+ * - `--bandwidth=<bytes per second>` limits the phy (0 for no limit)
+ * - `--size=<bytes>` transferred per measurement (default 65536)
+ * - `--path=<device path>` used for Link::File (default /home/bench.dat)
+ * - `--image=<host path>` OS image to time write_flash() -- this
+ *   reinstalls the OS on a device in the bootloader
+ * - `--fake` uses FakeTransport even if a device is attached
+ * - `--count=<devices>` scanned by get_info_list() (default 8, max 16)
+ *
+ * A device running the OS measures Link::File and Appfs::append().
+ * A device in the bootloader measures read_flash() and write_flash().
+ *
+ * If no device is attached (or with `--fake`), FakeTransport devices
+ * are measured instead: one running the OS and one in the bootloader.
+ * The fake bootloader is written with a generated image if `--image`
+ * isn't given. The serial and threaded get_info_list() scans are also
+ * timed over `--count` fake devices (the phy latency is what the
+ * threads overlap).
+ */
+class Bench : public test::Test {
+public:
+  explicit Bench(const sys::Cli &cli) : test::Test(cli.get_name()), m_cli(cli) {}
+
+  bool execute_class_performance_case() {
+    const auto latency
+      = chrono::MicroTime(m_cli.get_option("latency").to_integer());
+    const u32 bandwidth = m_cli.get_option("bandwidth").to_integer();
+    const auto shape
+      = ShapedPhy::Construct().set_latency(latency).set_bytes_per_second(
+        bandwidth);
+
+    printer()
+      .key("latencyMicroseconds", var::NumberString(latency.microseconds()))
+      .key("bandwidth", var::NumberString(bandwidth));
+
+    if (m_cli.get_option("fake") != "true") {
+      // the phy must outlive the link
+      ShapedPhy shaped_phy(shape);
+      Link link;
+      usb_link_transport_load_driver(link.driver());
+      shaped_phy.install(link.driver());
+
+      auto list = link.get_info_list();
+      if (list.count() > 0) {
+        printer().key("transport", var::StringView("usb"));
+        TEST_ASSERT(link.connect(list.front().path()).is_success());
+        TEST_ASSERT(device_case(link));
+        return true;
+      }
+    }
+
+    printer().key("transport", var::StringView("fake"));
+    for (const bool is_bootloader : {false, true}) {
+      FakeTransport fake_transport(FakeTransport::Construct()
+                                     .set_bootloader(is_bootloader)
+                                     .set_flash_size(bench_size())
+                                     .set_shape(shape));
+      Link link;
+      fake_transport.install(link.driver());
+
+      auto list = link.get_info_list();
+      TEST_ASSERT(list.count() == 1);
+      TEST_ASSERT(link.connect(list.front().path()).is_success());
+      TEST_ASSERT(link.is_bootloader() == is_bootloader);
+      m_is_fake = true;
+      TEST_ASSERT(device_case(link));
+    }
+
+    TEST_ASSERT(info_list_case(shape));
+    return true;
+  }
+
+  bool info_list_case(const ShapedPhy::Construct &shape) {
+    const u32 option_count = m_cli.get_option("count").to_integer();
+    const u32 device_count = std::min(
+      option_count ? option_count : 8,
+      FakeTransport::maximum_device_count);
+    FakeTransport fake_transport(
+      FakeTransport::Construct().set_device_count(device_count).set_shape(
+        shape));
+    Link link;
+    fake_transport.install(link.driver());
+
+    printer().key("infoListDeviceCount", var::NumberString(device_count));
+
+    // 1 is the serial scan
+    for (const u32 thread_count : {1, 2, 4, 8}) {
+      var::Vector<u32> sample_list;
+      chrono::ClockTimer total_timer;
+      total_timer.start();
+      for (u32 i = 0; i < 5; i++) {
+        chrono::ClockTimer timer;
+        timer.start();
+        const auto list = link.get_info_list(
+          Link::GetInfoList().set_thread_count(thread_count));
+        sample_list.push_back(u32(timer.micro_time().microseconds()));
+        TEST_ASSERT(list.count() == device_count);
+      }
+
+      printer().object(
+        var::KeyString().format("infoList@%d", thread_count),
+        BenchReport(sample_list, 0, total_timer.micro_time()));
+    }
+
+    return true;
+  }
+
+  bool device_case(Link &link) {
+    if (link.is_bootloader()) {
+      TEST_ASSERT(read_flash_case(link));
+      TEST_ASSERT(write_flash_case(link));
+    } else {
+      TEST_ASSERT(file_case(link));
+      TEST_ASSERT(appfs_case(link));
+    }
+    return true;
+  }
+
+  bool read_flash_case(Link &link) {
+    if (link.is_signature_required()) {
+      // the bootloader doesn't allow reading flash
+      printer().key_bool("readFlash", false);
+      return true;
+    }
+
+    bootloader_attr_t attr;
+    TEST_ASSERT(link.get_bootloader_attr(attr).is_success());
+
+    const u32 size = bench_size();
+    for (const u32 chunk_size : {256, 1024, 4096, 16384}) {
+      var::Data buffer(chunk_size);
+      var::Vector<u32> sample_list;
+      chrono::ClockTimer total_timer;
+      total_timer.start();
+      for (u32 offset = 0; offset < size; offset += chunk_size) {
+        chrono::ClockTimer timer;
+        timer.start();
+        TEST_ASSERT(
+          link.read_flash(attr.startaddr + offset, buffer.data(), chunk_size)
+            .is_success());
+        sample_list.push_back(u32(timer.micro_time().microseconds()));
+      }
+
+      printer().object(
+        var::KeyString().format("readFlash@%d", chunk_size),
+        BenchReport(sample_list, size, total_timer.micro_time()));
+    }
+
+    return true;
+  }
+
+  bool write_flash_case(Link &link) {
+    const auto image_path = m_cli.get_option("image");
+    if (image_path.is_empty()) {
+      if (m_is_fake == false) {
+        printer().key_bool("writeFlash", false);
+        return true;
+      }
+
+      // the fake bootloader only checks the hardware id
+      var::Data image(bench_size());
+      var::View(image).fill<u8>(0xaa);
+      const u32 hardware_id = link.info().hardware_id();
+      var::View(image)
+        .pop_front(BOOTLOADER_HARDWARE_ID_OFFSET)
+        .copy(var::View(hardware_id));
+      return write_image_case(link, var::View(image));
+    }
+
+    const Link::MappedImage image(image_path);
+    TEST_ASSERT(image.view().size() > 0);
+    return write_image_case(link, image.view());
+  }
+
+  bool write_image_case(Link &link, var::View image) {
+    for (const u32 chunk_size : {1024, 4096, 16384}) {
+      if (link.is_bootloader() == false) {
+        TEST_ASSERT(link.reset_bootloader()
+                      .reconnect(10, 200_milliseconds)
+                      .is_bootloader());
+      }
+
+      ProgressTimer progress_timer;
+      TEST_ASSERT(link(Link::UpdateOs()
+                         .set_image_view(image)
+                         .set_chunk_size(chunk_size)
+                         .set_printer(&printer())
+                         .set_progress_callback(
+                           progress_timer.progress_callback()))
+                    .is_success());
+
+      printer().object(
+        var::KeyString().format("writeFlash@%d", chunk_size),
+        BenchReport(
+          progress_timer.sample_list(),
+          image.size(),
+          link.update_report().write_duration()));
+
+      link.reset_bootloader().reconnect(10, 200_milliseconds);
+    }
+
+    return true;
+  }
+
+  bool file_case(Link &link) {
+    const auto path = m_cli.get_option("path").is_empty()
+                        ? var::StringView("/home/bench.dat")
+                        : m_cli.get_option("path");
+    const u32 size = bench_size();
+
+    for (const u32 chunk_size : {64, 512, 4096}) {
+      var::Data buffer(chunk_size);
+      var::View(buffer).fill<u8>(0xaa);
+
+      {
+        Link::File file(
+          Link::File::IsOverwrite::yes,
+          path,
+          fs::OpenMode::read_write(),
+          fs::Permissions(0666),
+          link.driver());
+        TEST_ASSERT(file.is_success());
+
+        var::Vector<u32> sample_list;
+        chrono::ClockTimer total_timer;
+        total_timer.start();
+        for (u32 offset = 0; offset < size; offset += chunk_size) {
+          chrono::ClockTimer timer;
+          timer.start();
+          TEST_ASSERT(file.write(var::View(buffer)).is_success());
+          sample_list.push_back(u32(timer.micro_time().microseconds()));
+        }
+
+        printer().object(
+          var::KeyString().format("fileWrite@%d", chunk_size),
+          BenchReport(sample_list, size, total_timer.micro_time()));
+      }
+
+      {
+        Link::File file(path, fs::OpenMode::read_only(), link.driver());
+        TEST_ASSERT(file.is_success());
+
+        var::Vector<u32> sample_list;
+        chrono::ClockTimer total_timer;
+        total_timer.start();
+        for (u32 offset = 0; offset < size; offset += chunk_size) {
+          chrono::ClockTimer timer;
+          timer.start();
+          TEST_ASSERT(file.read(var::View(buffer)).is_success());
+          sample_list.push_back(u32(timer.micro_time().microseconds()));
+        }
+
+        printer().object(
+          var::KeyString().format("fileRead@%d", chunk_size),
+          BenchReport(sample_list, size, total_timer.micro_time()));
+      }
+    }
+
+    TEST_ASSERT(Link::FileSystem(link.driver()).remove(path).is_success());
+    return true;
+  }
+
+  bool appfs_case(Link &link) {
+    const u32 size = bench_size();
+    var::Data data(size);
+    var::View(data).fill<u8>(0xaa);
+
+    ProgressTimer progress_timer;
+    chrono::ClockTimer total_timer;
+    total_timer.start();
+    TEST_ASSERT(Appfs(
+                  Appfs::Construct()
+                    .set_name("bench")
+                    .set_size(size)
+                    .set_overwrite(true),
+                  link.driver())
+                  .append(
+                    fs::ViewFile(var::View(data)),
+                    progress_timer.progress_callback())
+                  .is_success());
+
+    printer().object(
+      "appfsAppend",
+      BenchReport(
+        progress_timer.sample_list(),
+        size,
+        total_timer.micro_time()));
+
+    TEST_ASSERT(
+      Link::FileSystem(link.driver()).remove("/app/flash/bench").is_success());
+    return true;
+  }
+
+private:
+  const sys::Cli &m_cli;
+  bool m_is_fake = false;
+
+  API_NO_DISCARD u32 bench_size() const {
+    const u32 result = m_cli.get_option("size").to_integer();
+    return result ? result : 65536;
+  }
+};
+
+#endif
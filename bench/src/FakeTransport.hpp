@@ -0,0 +1,695 @@
+
+#ifndef SOSAPI_BENCH_FAKE_TRANSPORT_HPP
+#define SOSAPI_BENCH_FAKE_TRANSPORT_HPP
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+#include <sos/dev/appfs.h>
+#include <sos/dev/sys.h>
+#include <sos/link.h>
+
+#include <var.hpp>
+
+#include "ShapedPhy.hpp"
+
+/*
+ * Devices that run in the bench process and answer the link
+ * protocol so the bench can run without hardware.
+ *
+ * install() replaces the phy of a link driver. Each open() starts a
+ * session with one device. Packets written by the host are
+ * acknowledged and decoded, then the replies are queued as packets
+ * for the host to read. Transfers are shaped like ShapedPhy using
+ * the shape() of this object.
+ *
+ * A device is either in the bootloader or running the OS:
+ * - the bootloader answers I_BOOTLOADER_GETINFO, I_BOOTLOADER_ERASE and
+ *   I_BOOTLOADER_WRITEPAGE and reads flash on LINK_BOOTLOADER_FILDES
+ * - the OS answers I_SYS_GETINFO on /dev/sys, keeps files in memory
+ *   and answers I_APPFS_CREATE on /app/.install by creating
+ *   /app/flash/<name>
+ *
+ * Other requests succeed without doing anything. Other commands fail
+ * with ENOTSUP.
+ *
+ * getname() doesn't have a context so it lists maximum_device_count
+ * paths. Opening a path past device_count() fails like an unplugged
+ * port. A device should only be opened by one Link at a time and
+ * this object must outlive any Link that uses the driver.
+ */
+class FakeTransport {
+public:
+  using handle_t = ShapedPhy::handle_t;
+
+  static constexpr u32 maximum_device_count = 16;
+  static constexpr u32 hardware_id = 0x00000100;
+  static constexpr u32 flash_start_address = 0x00040000;
+
+  class Construct {
+    API_AF(Construct, u32, device_count, 1);
+    API_AB(Construct, bootloader, false);
+    // size of the bootloader's flash
+    API_AF(Construct, u32, flash_size, 1024 * 1024);
+    API_AC(Construct, ShapedPhy::Construct, shape);
+  };
+
+  explicit FakeTransport(const Construct &options) : m_construct(options) {
+    const u32 count = options.device_count() < maximum_device_count
+                        ? options.device_count()
+                        : maximum_device_count;
+    m_device_list.resize(count);
+    for (u32 i = 0; i < count; i++) {
+      Device &device = m_device_list.at(i);
+      device.index = i;
+      if (options.is_bootloader()) {
+        device.flash = var::Data(options.flash_size());
+        var::View(device.flash).fill<u8>(0xff);
+      }
+    }
+  }
+
+  FakeTransport(const FakeTransport &a) = delete;
+  FakeTransport &operator=(const FakeTransport &a) = delete;
+
+  void install(link_transport_mdriver_t *driver) {
+    driver->options = this;
+    driver->getname = getname;
+    driver->phy_driver.open = open;
+    driver->phy_driver.close = close;
+    driver->phy_driver.write = write;
+    driver->phy_driver.read = read;
+    driver->phy_driver.flush = flush;
+  }
+
+  API_NO_DISCARD const Construct &construct() const { return m_construct; }
+
+private:
+  static constexpr const char *path_prefix = "/fake/";
+  static constexpr size_t packet_header_size = offsetof(link_pkt_t, data);
+  // the last byte of data holds the checksum
+  static constexpr size_t packet_data_size = sizeof(link_pkt_t::data) - 1;
+
+  struct File {
+    var::PathString path;
+    var::Data data;
+  };
+
+  struct Device {
+    u32 index = 0;
+    var::Data flash;
+    var::Vector<File> file_list;
+  };
+
+  enum class Type { file, sys, install };
+
+  struct Descriptor {
+    int fd = -1;
+    Type type = Type::file;
+    var::PathString path;
+    u32 offset = 0;
+  };
+
+  class Session {
+  public:
+    Session(const FakeTransport *transport, Device *device)
+      : m_transport(transport), m_device(device) {}
+
+    API_NO_DISCARD const ShapedPhy::Construct &shape() const {
+      return m_transport->construct().shape();
+    }
+
+    int write(const void *buf, int nbyte) {
+      const auto *data = reinterpret_cast<const u8 *>(buf);
+      m_input.insert(m_input.end(), data, data + nbyte);
+      while (decode_input()) {
+      }
+      return nbyte;
+    }
+
+    int read(void *buf, int nbyte) {
+      // one packet at a time like a bulk transfer
+      if (m_output_list.empty() || nbyte <= 0) {
+        return 0;
+      }
+
+      const std::vector<u8> &output = m_output_list.front();
+      const size_t size_left = output.size() - m_output_offset;
+      const size_t size = size_left < size_t(nbyte) ? size_left : nbyte;
+      memcpy(buf, output.data() + m_output_offset, size);
+      m_output_offset += size;
+      if (m_output_offset == output.size()) {
+        m_output_list.pop_front();
+        m_output_offset = 0;
+      }
+      return int(size);
+    }
+
+    void flush() {
+      m_input.clear();
+      m_command.clear();
+      m_output_list.clear();
+      m_output_offset = 0;
+    }
+
+  private:
+    const FakeTransport *m_transport;
+    Device *m_device;
+    // bytes from the host that aren't a complete packet yet
+    std::vector<u8> m_input;
+    // packet data that isn't a complete command yet
+    std::vector<u8> m_command;
+    std::deque<std::vector<u8>> m_output_list;
+    size_t m_output_offset = 0;
+    var::Vector<Descriptor> m_descriptor_list;
+    int m_next_fd = 3;
+
+    API_NO_DISCARD bool is_bootloader() const {
+      return m_transport->construct().is_bootloader();
+    }
+
+    void queue(var::View data) {
+      m_output_list.emplace_back(
+        data.to_const_u8(),
+        data.to_const_u8() + data.size());
+    }
+
+    void send(var::View data) {
+      size_t offset = 0;
+      while (offset < data.size()) {
+        const size_t size_left = data.size() - offset;
+        const size_t size
+          = size_left < packet_data_size ? size_left : packet_data_size;
+        link_pkt_t packet;
+        packet.start = LINK_PACKET_START;
+        packet.size = u8(size);
+        memcpy(packet.data, data.to_const_u8() + offset, size);
+        link_transport_insert_checksum(&packet);
+        queue(var::View(&packet, packet_header_size + size + 1));
+        offset += size;
+      }
+    }
+
+    void send_reply(const link_reply_t &reply) { send(var::View(reply)); }
+
+    static link_reply_t get_reply(int value, int error_number = 0) {
+      link_reply_t result;
+      result.err = value;
+      result.err_number = error_number;
+      return result;
+    }
+
+    bool decode_input() {
+      if (m_input.empty()) {
+        return false;
+      }
+
+      const u8 start = m_input.front();
+      if (start == LINK_PACKET_ACK || start == LINK_PACKET_NACK) {
+        // the host acknowledges each packet that it reads
+        if (m_input.size() < sizeof(link_ack_t)) {
+          return false;
+        }
+        consume_input(sizeof(link_ack_t));
+        return true;
+      }
+
+      if (start != LINK_PACKET_START) {
+        consume_input(1);
+        return true;
+      }
+
+      if (m_input.size() < packet_header_size) {
+        return false;
+      }
+
+      const size_t size = m_input.at(offsetof(link_pkt_t, size));
+      if (size > packet_data_size) {
+        consume_input(1);
+        return true;
+      }
+
+      if (m_input.size() < packet_header_size + size + 1) {
+        return false;
+      }
+
+      const auto data_begin = m_input.begin() + packet_header_size;
+      m_command.insert(m_command.end(), data_begin, data_begin + size);
+
+      link_ack_t ack;
+      ack.ack = LINK_PACKET_ACK;
+      ack.checksum = m_input.at(packet_header_size + size);
+      consume_input(packet_header_size + size + 1);
+      queue(var::View(ack));
+
+      while (execute_command()) {
+      }
+      return true;
+    }
+
+    void consume_input(size_t size) {
+      m_input.erase(m_input.begin(), m_input.begin() + size);
+    }
+
+    static size_t get_op_size(u16 cmd) {
+      switch (cmd) {
+      case LINK_CMD_OPEN:
+        return sizeof(link_open_t);
+      case LINK_CMD_CLOSE:
+        return sizeof(link_close_t);
+      case LINK_CMD_READ:
+        return sizeof(link_read_t);
+      case LINK_CMD_WRITE:
+        return sizeof(link_write_t);
+      case LINK_CMD_IOCTL:
+        return sizeof(link_ioctl_t);
+      case LINK_CMD_UNLINK:
+        return sizeof(link_unlink_t);
+      default:
+        return 0;
+      }
+    }
+
+    static size_t get_payload_size(const link_op_t &op) {
+      switch (op.cmd) {
+      case LINK_CMD_OPEN:
+        return op.open.path_size;
+      case LINK_CMD_WRITE:
+        return op.write.nbyte > 0 ? op.write.nbyte : 0;
+      case LINK_CMD_IOCTL:
+        return _IOCTL_IOCTLW(op.ioctl.request) ? _IOCTL_SIZE(op.ioctl.request)
+                                               : 0;
+      case LINK_CMD_UNLINK:
+        return op.unlink.path_size;
+      default:
+        return 0;
+      }
+    }
+
+    bool execute_command() {
+      u16 cmd;
+      if (m_command.size() < sizeof(cmd)) {
+        return false;
+      }
+      memcpy(&cmd, m_command.data(), sizeof(cmd));
+
+      const size_t op_size = get_op_size(cmd);
+      if (op_size == 0) {
+        // the size of the rest of the command isn't known
+        m_command.clear();
+        send_reply(get_reply(-1, ENOTSUP));
+        return false;
+      }
+
+      if (m_command.size() < op_size) {
+        return false;
+      }
+
+      link_op_t op;
+      memcpy(&op, m_command.data(), op_size);
+      const size_t payload_size = get_payload_size(op);
+      if (m_command.size() < op_size + payload_size) {
+        return false;
+      }
+
+      execute(op, var::View(m_command.data() + op_size, payload_size));
+      m_command.erase(
+        m_command.begin(),
+        m_command.begin() + op_size + payload_size);
+      return true;
+    }
+
+    void execute(const link_op_t &op, var::View payload) {
+      switch (op.cmd) {
+      case LINK_CMD_OPEN:
+        send_reply(open(get_path(payload), op.open.flags));
+        return;
+      case LINK_CMD_CLOSE:
+        send_reply(close(op.close.fildes));
+        return;
+      case LINK_CMD_READ: {
+        var::Data buffer(op.read.nbyte > 0 ? op.read.nbyte : 0);
+        const link_reply_t reply
+          = read(op.read.fildes, op.read.addr, var::View(buffer));
+        send_reply(reply);
+        if (reply.err > 0) {
+          send(var::View(buffer).truncate(reply.err));
+        }
+        return;
+      }
+      case LINK_CMD_WRITE:
+        send_reply(write(op.write.fildes, payload));
+        return;
+      case LINK_CMD_IOCTL: {
+        const int request = op.ioctl.request;
+        var::Data output(_IOCTL_IOCTLR(request) ? _IOCTL_SIZE(request) : 0);
+        const link_reply_t reply
+          = ioctl(op.ioctl.fildes, request, payload, var::View(output));
+        send(var::View(output));
+        send_reply(reply);
+        return;
+      }
+      case LINK_CMD_UNLINK:
+        send_reply(unlink(get_path(payload)));
+        return;
+      }
+    }
+
+    static var::PathString get_path(var::View payload) {
+      // the payload includes the null terminator
+      var::PathString result;
+      const size_t size = payload.size() < result.capacity()
+                            ? payload.size()
+                            : result.capacity();
+      memcpy(result.data(), payload.to_const_u8(), size);
+      return result;
+    }
+
+    File *find_file(var::StringView path) {
+      for (File &file : m_device->file_list) {
+        if (file.path.string_view() == path) {
+          return &file;
+        }
+      }
+      return nullptr;
+    }
+
+    Descriptor *find_descriptor(int fd) {
+      for (Descriptor &descriptor : m_descriptor_list) {
+        if (descriptor.fd == fd) {
+          return &descriptor;
+        }
+      }
+      return nullptr;
+    }
+
+    link_reply_t add_descriptor(Type type, const var::PathString &path) {
+      Descriptor descriptor;
+      descriptor.fd = m_next_fd++;
+      descriptor.type = type;
+      descriptor.path = path;
+      m_descriptor_list.push_back(descriptor);
+      return get_reply(descriptor.fd);
+    }
+
+    link_reply_t open(const var::PathString &path, int flags) {
+      if (is_bootloader()) {
+        return get_reply(-1, ENOTSUP);
+      }
+
+      if (path.string_view() == "/dev/sys") {
+        return add_descriptor(Type::sys, path);
+      }
+
+      if (path.string_view() == "/app/.install") {
+        return add_descriptor(Type::install, path);
+      }
+
+      File *file = find_file(path.string_view());
+      if (file == nullptr) {
+        if ((flags & LINK_O_CREAT) == 0) {
+          return get_reply(-1, ENOENT);
+        }
+        File new_file;
+        new_file.path = path;
+        m_device->file_list.push_back(std::move(new_file));
+      } else if ((flags & LINK_O_CREAT) && (flags & LINK_O_EXCL)) {
+        return get_reply(-1, EEXIST);
+      } else if (flags & LINK_O_TRUNC) {
+        file->data = var::Data();
+      }
+
+      return add_descriptor(Type::file, path);
+    }
+
+    link_reply_t close(int fd) {
+      for (size_t i = 0; i < m_descriptor_list.count(); i++) {
+        if (m_descriptor_list.at(i).fd == fd) {
+          m_descriptor_list.remove(i);
+          return get_reply(0);
+        }
+      }
+      return get_reply(-1, EBADF);
+    }
+
+    link_reply_t unlink(const var::PathString &path) {
+      var::Vector<File> &file_list = m_device->file_list;
+      for (size_t i = 0; i < file_list.count(); i++) {
+        if (file_list.at(i).path.string_view() == path.string_view()) {
+          file_list.remove(i);
+          return get_reply(0);
+        }
+      }
+      return get_reply(-1, ENOENT);
+    }
+
+    link_reply_t read(int fd, int address, var::View destination) {
+      if (fd == LINK_BOOTLOADER_FILDES) {
+        if (is_bootloader() == false) {
+          return get_reply(-1, EBADF);
+        }
+        const var::View flash = get_flash(address, destination.size());
+        if (flash.size() == 0) {
+          return get_reply(-1, EINVAL);
+        }
+        destination.copy(flash);
+        return get_reply(int(flash.size()));
+      }
+
+      Descriptor *descriptor = find_descriptor(fd);
+      File *file = descriptor && descriptor->type == Type::file
+                     ? find_file(descriptor->path.string_view())
+                     : nullptr;
+      if (file == nullptr) {
+        return get_reply(-1, EBADF);
+      }
+
+      if (descriptor->offset >= file->data.size()) {
+        return get_reply(0);
+      }
+
+      const var::View source = var::View(file->data)
+                                 .pop_front(descriptor->offset)
+                                 .truncate(destination.size());
+      destination.copy(source);
+      descriptor->offset += source.size();
+      return get_reply(int(source.size()));
+    }
+
+    link_reply_t write(int fd, var::View source) {
+      Descriptor *descriptor = find_descriptor(fd);
+      File *file = descriptor && descriptor->type == Type::file
+                     ? find_file(descriptor->path.string_view())
+                     : nullptr;
+      if (file == nullptr) {
+        return get_reply(-1, EBADF);
+      }
+
+      const u32 end = descriptor->offset + source.size();
+      if (end > file->data.size()) {
+        file->data.resize(end);
+      }
+      var::View(file->data).pop_front(descriptor->offset).copy(source);
+      descriptor->offset = end;
+      return get_reply(int(source.size()));
+    }
+
+    link_reply_t
+    ioctl(int fd, int request, var::View input, var::View output) {
+      if (fd == LINK_BOOTLOADER_FILDES) {
+        // link_isbootloader() relies on the OS rejecting this
+        if (is_bootloader() == false) {
+          return get_reply(-1, EBADF);
+        }
+        return ioctl_bootloader(request, input, output);
+      }
+
+      Descriptor *descriptor = find_descriptor(fd);
+      if (descriptor == nullptr) {
+        return get_reply(-1, EBADF);
+      }
+
+      if (descriptor->type == Type::sys && request == I_SYS_GETINFO) {
+        sys_info_t sys_info;
+        memset(&sys_info, 0, sizeof(sys_info));
+        strcpy(sys_info.name, "fake");
+        sys_info.hardware_id = hardware_id;
+        copy_serial_number(&sys_info.serial, sizeof(sys_info.serial));
+        output.copy(var::View(sys_info));
+        return get_reply(0);
+      }
+
+      if (descriptor->type == Type::install && request == I_APPFS_CREATE) {
+        appfs_createattr_t attributes;
+        var::View(attributes).copy(input);
+        return create_app(*descriptor, attributes);
+      }
+
+      return get_reply(0);
+    }
+
+    link_reply_t
+    ioctl_bootloader(int request, var::View input, var::View output) {
+      switch (request) {
+      case I_BOOTLOADER_GETINFO: {
+        bootloader_attr_t attributes;
+        memset(&attributes, 0, sizeof(attributes));
+        attributes.version = 0x400;
+        attributes.hardware_id = hardware_id;
+        attributes.startaddr = flash_start_address;
+        copy_serial_number(attributes.serialno, sizeof(attributes.serialno));
+        output.copy(var::View(attributes));
+        return get_reply(0);
+      }
+      case I_BOOTLOADER_ERASE:
+        var::View(m_device->flash).fill<u8>(0xff);
+        return get_reply(0);
+      case I_BOOTLOADER_WRITEPAGE: {
+        bootloader_writepage_t write_page;
+        var::View(write_page).copy(input);
+        const u32 size = write_page.nbyte < sizeof(write_page.buf)
+                           ? write_page.nbyte
+                           : sizeof(write_page.buf);
+        var::View flash = get_flash(write_page.addr, size);
+        if (flash.size() != size) {
+          return get_reply(-1, EINVAL);
+        }
+        // programming flash can only clear bits
+        auto *destination = static_cast<u8 *>(flash.to_void());
+        for (u32 i = 0; i < size; i++) {
+          destination[i] &= write_page.buf[i];
+        }
+        return get_reply(0);
+      }
+      default:
+        return get_reply(0);
+      }
+    }
+
+    link_reply_t
+    create_app(Descriptor &descriptor, const appfs_createattr_t &attributes) {
+      if (attributes.loc == 0) {
+        // the first page starts with the file header
+        appfs_file_t header;
+        var::View(header).copy(var::View(attributes.buffer));
+        char name[sizeof(header.hdr.name) + 1] = {};
+        memcpy(name, header.hdr.name, sizeof(header.hdr.name));
+
+        File file;
+        file.path = var::PathString("/app/flash/").append(name);
+        file.data = var::Data(header.exec.code_size);
+        var::View(file.data).fill<u8>(0xff);
+        unlink(file.path);
+        descriptor.path = file.path;
+        m_device->file_list.push_back(std::move(file));
+      }
+
+      File *file = find_file(descriptor.path.string_view());
+      if (file == nullptr) {
+        return get_reply(-1, EINVAL);
+      }
+
+      if (attributes.loc + attributes.nbyte > file->data.size()) {
+        return get_reply(-1, ENOSPC);
+      }
+
+      var::View(file->data)
+        .pop_front(attributes.loc)
+        .copy(var::View(attributes.buffer).truncate(attributes.nbyte));
+      return get_reply(0);
+    }
+
+    var::View get_flash(u32 address, u32 size) {
+      var::Data &flash = m_device->flash;
+      if (
+        address < flash_start_address
+        || address - flash_start_address + size > flash.size()) {
+        return var::View();
+      }
+      return var::View(flash).pop_front(address - flash_start_address).truncate(
+        size);
+    }
+
+    void copy_serial_number(void *destination, size_t size) const {
+      const u32 serial_number[4] = {0x46414b45, 0, 0, m_device->index + 1};
+      memcpy(
+        destination,
+        serial_number,
+        size < sizeof(serial_number) ? size : sizeof(serial_number));
+    }
+  };
+
+  Construct m_construct;
+  var::Vector<Device> m_device_list;
+
+  static Session *get_session(handle_t handle) {
+    return reinterpret_cast<Session *>(handle);
+  }
+
+  static int getname(char *dest, const char *last, int len) {
+    const size_t prefix_length = strlen(path_prefix);
+    const u32 index = last == nullptr || last[0] == 0
+                        ? 0
+                        : u32(atoi(last + prefix_length)) + 1;
+    if (index >= maximum_device_count) {
+      return -1;
+    }
+    snprintf(
+      dest,
+      len,
+      "%s%lu",
+      path_prefix,
+      static_cast<unsigned long>(index));
+    return 0;
+  }
+
+  static handle_t open(const char *path, const void *options) {
+    // install() sets the options to this object
+    auto *self = const_cast<FakeTransport *>(
+      reinterpret_cast<const FakeTransport *>(options));
+    const size_t prefix_length = strlen(path_prefix);
+    if (
+      strlen(path) <= prefix_length
+      || strncmp(path, path_prefix, prefix_length) != 0) {
+      errno = ENODEV;
+      return LINK_PHY_OPEN_ERROR;
+    }
+
+    const u32 index = u32(atoi(path + prefix_length));
+    if (index >= self->m_device_list.count()) {
+      errno = ENODEV;
+      return LINK_PHY_OPEN_ERROR;
+    }
+
+    return reinterpret_cast<handle_t>(
+      new Session(self, &self->m_device_list.at(index)));
+  }
+
+  static int close(handle_t *handle) {
+    delete get_session(*handle);
+    *handle = LINK_PHY_OPEN_ERROR;
+    return 0;
+  }
+
+  static int write(handle_t handle, const void *buf, int nbyte) {
+    Session *session = get_session(handle);
+    ShapedPhy::wait_write(session->shape(), nbyte);
+    return session->write(buf, nbyte);
+  }
+
+  static int read(handle_t handle, void *buf, int nbyte) {
+    Session *session = get_session(handle);
+    const int result = session->read(buf, nbyte);
+    ShapedPhy::wait_read(session->shape(), result);
+    return result;
+  }
+
+  static void flush(handle_t handle) { get_session(handle)->flush(); }
+};
+
+#endif // SOSAPI_BENCH_FAKE_TRANSPORT_HPP
@@ -0,0 +1,117 @@
+
+#ifndef SOSAPI_BENCH_SHAPED_PHY_HPP
+#define SOSAPI_BENCH_SHAPED_PHY_HPP
+
+#include <chrono.hpp>
+#include <sos/link.h>
+
+/*
+ * Wraps the phy of a link driver so each transfer is delayed
+ * by a fixed latency plus the time it takes at a given bandwidth.
+ *
+ * This lets a fast connection (like USB) be measured as if it were
+ * a slower one (like a UART bridge). The phy functions don't have a
+ * context so install() points the driver options at this object and
+ * each open() returns a handle that refers back to it. The object
+ * must outlive any Link that uses the driver.
+ */
+class ShapedPhy {
+public:
+  using phy_driver_t = decltype(link_transport_mdriver_t::phy_driver);
+  using handle_t = decltype(phy_driver_t::handle);
+
+  class Construct {
+    API_AC(Construct, chrono::MicroTime, latency);
+    // 0 means no limit
+    API_AF(Construct, u32, bytes_per_second, 0);
+  };
+
+  explicit ShapedPhy(const Construct &options) : m_construct(options) {}
+
+  ShapedPhy(const ShapedPhy &a) = delete;
+  ShapedPhy &operator=(const ShapedPhy &a) = delete;
+
+  void install(link_transport_mdriver_t *driver) {
+    m_phy = driver->phy_driver;
+    m_options = driver->options;
+    driver->options = this;
+    driver->phy_driver.open = open;
+    driver->phy_driver.close = close;
+    driver->phy_driver.write = write;
+    driver->phy_driver.read = read;
+    driver->phy_driver.flush = flush;
+  }
+
+  // also used by FakeTransport which has its own phy
+  static void wait_write(const Construct &options, int nbyte) {
+    if (options.latency().microseconds()) {
+      chrono::wait(options.latency());
+    }
+    wait_transfer(options, nbyte);
+  }
+
+  static void wait_read(const Construct &options, int nbyte) {
+    wait_transfer(options, nbyte);
+  }
+
+private:
+  struct Handle {
+    const ShapedPhy *shaped_phy;
+    handle_t handle;
+  };
+
+  phy_driver_t m_phy = {};
+  const void *m_options = nullptr;
+  Construct m_construct;
+
+  static void wait_transfer(const Construct &options, int nbyte) {
+    if (options.bytes_per_second() && nbyte > 0) {
+      chrono::wait(chrono::MicroTime(
+        u64(nbyte) * 1000000 / options.bytes_per_second()));
+    }
+  }
+
+  static Handle *get_handle(handle_t handle) {
+    return reinterpret_cast<Handle *>(handle);
+  }
+
+  static handle_t open(const char *path, const void *options) {
+    const auto *self = reinterpret_cast<const ShapedPhy *>(options);
+    const handle_t handle = self->m_phy.open(path, self->m_options);
+    if (handle == LINK_PHY_OPEN_ERROR) {
+      return LINK_PHY_OPEN_ERROR;
+    }
+    return reinterpret_cast<handle_t>(new Handle{self, handle});
+  }
+
+  static int close(handle_t *handle) {
+    Handle *shaped_handle = get_handle(*handle);
+    const int result
+      = shaped_handle->shaped_phy->m_phy.close(&shaped_handle->handle);
+    delete shaped_handle;
+    *handle = LINK_PHY_OPEN_ERROR;
+    return result;
+  }
+
+  static int write(handle_t handle, const void *buf, int nbyte) {
+    const Handle *shaped_handle = get_handle(handle);
+    const ShapedPhy *self = shaped_handle->shaped_phy;
+    wait_write(self->m_construct, nbyte);
+    return self->m_phy.write(shaped_handle->handle, buf, nbyte);
+  }
+
+  static int read(handle_t handle, void *buf, int nbyte) {
+    const Handle *shaped_handle = get_handle(handle);
+    const ShapedPhy *self = shaped_handle->shaped_phy;
+    const int result = self->m_phy.read(shaped_handle->handle, buf, nbyte);
+    wait_read(self->m_construct, result);
+    return result;
+  }
+
+  static void flush(handle_t handle) {
+    const Handle *shaped_handle = get_handle(handle);
+    shaped_handle->shaped_phy->m_phy.flush(shaped_handle->handle);
+  }
+};
+
+#endif // SOSAPI_BENCH_SHAPED_PHY_HPP
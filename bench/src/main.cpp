@@ -0,0 +1,38 @@
+
+
+#include <signal.h>
+#include <sys/Cli.hpp>
+
+#include "Bench.hpp"
+
+#define VERSION "0.1"
+
+void segfault(int a) { API_ASSERT(false); }
+
+int main(int argc, char *argv[]) {
+
+  sys::Cli cli(argc, argv);
+
+#if defined __link
+  signal(11, segfault);
+#endif
+
+  printer::Printer printer;
+
+  printer.set_verbose_level(cli.get_option("verbose"));
+
+  test::Test::initialize(test::Test::Initialize()
+                           .set_name(cli.get_name())
+                           .set_version(VERSION)
+                           .set_git_hash(SOS_GIT_HASH)
+                           .set_printer(&printer));
+
+#if defined __link
+  { Bench(cli).execute(cli); }
+#endif
+
+  test::Test::finalize();
+
+  exit(test::Test::final_result() == false);
+  return 0;
+}
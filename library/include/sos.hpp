@@ -8,7 +8,12 @@ namespace sos {
 
 #include "sos/Appfs.hpp"
 #include "sos/Auth.hpp"
+#include "sos/ImageStore.hpp"
 #include "sos/Link.hpp"
+#include "sos/LinkAsync.hpp"
+#include "sos/LinkMonitor.hpp"
+#include "sos/LinkPool.hpp"
+#include "sos/LinkUpdater.hpp"
 #include "sos/Sos.hpp"
 #include "sos/Sys.hpp"
 #include "sos/TaskManager.hpp"
@@ -5,10 +5,12 @@
 
 #include <api/api.hpp>
 #include <fs/File.hpp>
+#include <printer/Printer.hpp>
 #include <var/String.hpp>
 
 #include <sos/dev/appfs.h>
 
+#include "Auth.hpp"
 #include "Link.hpp"
 
 namespace sos {
@@ -258,8 +260,18 @@ public:
     const fs::FileObject &file,
     const api::ProgressCallback *progress_callback = nullptr);
 
+#if SOS_API_USE_CRYPTO_API
+  // the signature info of an install if it is already known (see
+  // ImageStore::Entry::signature_info()) so the input is read straight
+  // into each page rather than holding back the signature marker
+  Appfs &set_signature_info(const Auth::SignatureInfo &value) {
+    m_signature_info = value;
+    return *this;
+  }
+#endif
+
   API_NO_DISCARD bool is_append_ready() const {
-    return m_bytes_written < m_data_size;
+    return !m_is_aborted && m_bytes_written < m_data_size;
   }
 
   API_NO_DISCARD bool is_valid() const { return m_data_size != 0; }
@@ -270,6 +282,69 @@ public:
     return m_data_size - m_bytes_written;
   }
 
+  using InfoList = var::Vector<Info>;
+
+  /*
+   * Remembers the apps found by get_inventory(). A directory's
+   * headers are only read again if its listing changes. Installing
+   * an app with a name that is already listed doesn't change the
+   * listing, so call invalidate() (or pass the cache to install()).
+   */
+  class InventoryCache {
+  public:
+    InventoryCache &invalidate() {
+      m_flash = Directory();
+      m_ram = Directory();
+      return *this;
+    }
+
+    // directories that were listed without reading the headers again
+    API_NO_DISCARD u32 hit_count() const { return m_hit_count; }
+
+  private:
+    friend class Appfs;
+    struct Directory {
+      bool is_valid = false;
+      var::Vector<var::NameString> name_list;
+      InfoList info_list;
+    };
+
+    Directory m_flash;
+    Directory m_ram;
+    u32 m_hit_count = 0;
+  };
+
+  // every app and data file in /app/flash then /app/ram -- a missing
+  // directory and entries that aren't apps are skipped, other errors
+  // are returned and the cache isn't updated
+  API_NO_DISCARD InfoList
+  get_inventory(InventoryCache *inventory_cache = nullptr) const;
+
+  enum class InstallStatus { null, skipped, installed };
+
+  // installs an executable unless the device already has the same build
+  class Install {
+  private:
+    // the header is read and then the file is installed from the same
+    // location so it must be seekable unless it is streamed (see name)
+    API_AF(Install, const fs::FileObject *, file, nullptr);
+    // name on the device (replaces the name in the header) -- with
+    // skip_unchanged off, the file is streamed once without reading its
+    // header (so it can be a pipe). The header is part of a signed
+    // image so renaming a signed app invalidates its signature.
+    API_AC(Install, var::StringView, name);
+    // skip the install if signature, version, id and the o_flags that
+    // are set by the build match the app installed with the same name
+    API_AB(Install, skip_unchanged, true);
+    API_AF(Install, const api::ProgressCallback *, progress_callback, nullptr);
+    // prints `<name>: skipped|installed` if not null
+    API_AF(Install, printer::Printer *, printer, nullptr);
+    // invalidated if the app is installed
+    API_AF(Install, InventoryCache *, inventory_cache, nullptr);
+  };
+
+  InstallStatus install(const Install &options);
+
   API_NO_DISCARD bool is_flash_available() const;
   API_NO_DISCARD bool is_ram_available() const;
 
@@ -303,9 +378,28 @@ private:
   u32 m_bytes_written = 0;
   u32 m_data_size = 0;
   int m_request = I_APPFS_CREATE;
+  // set by abort_append()
+  bool m_is_aborted = false;
+  // replaces the header name of an install
+  var::NameString m_name;
+#if SOS_API_USE_CRYPTO_API
+  // size() is zero if not known
+  Auth::SignatureInfo m_signature_info;
+#endif
 
   void create_asynchronous(const Construct &options);
   void append_view(var::View blob);
+  // counts size bytes already in the page buffer and sends full pages
+  void commit_page_data(u32 size);
+  // sends the page buffer at the current location
+  void write_page();
+  // the device has a partial app that can't be appended to
+  Appfs &abort_append();
+  // returns true if the cached headers were used
+  bool append_inventory(
+    InfoList &info_list,
+    var::StringView directory,
+    InventoryCache::Directory *cache) const;
 };
 
 } // namespace sos
@@ -0,0 +1,109 @@
+// Copyright 2016-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SOSAPI_SOS_IMAGESTORE_HPP
+#define SOSAPI_SOS_IMAGESTORE_HPP
+
+#include "macros.hpp"
+
+#if defined __link && SOS_API_USE_CRYPTO_API
+
+#include <crypto/Sha256.hpp>
+#include <var/String.hpp>
+#include <var/Vector.hpp>
+
+#include "Auth.hpp"
+
+namespace sos {
+
+/*! \brief ImageStore Class
+ * \details The ImageStore class remembers what has been
+ * parsed from OS and application images so that deploying
+ * the same image again doesn't hash or parse it again.
+ *
+ * Entries are keyed by the SHA-256 hash of the image. Images
+ * are also indexed by path, size, and modification time (with
+ * nanoseconds where the host provides them) so an unchanged file
+ * is found without reading it. The store
+ * is loaded when constructed and saved when destroyed (if it
+ * changed). It is not thread safe.
+ *
+ * ```cpp
+ * ImageStore image_store("images.dat");
+ * const auto entry = image_store.get("os.bin");
+ * link.update_os(Link::UpdateOs()
+ *   .set_image_view(Link::MappedImage("os.bin").view())
+ *   .set_image_hash(var::View(entry.hash()))
+ *   .set_image_store(&image_store)
+ *   .set_printer(&printer));
+ *
+ * Appfs appfs(Appfs::Construct().set_name("app"), link.driver());
+ * appfs.set_signature_info(image_store.get("app.bin").signature_info())
+ *   .append(File("app.bin"));
+ * ```
+ *
+ */
+class ImageStore : public api::ExecutionContext {
+public:
+  class Entry {
+  public:
+    API_NO_DISCARD bool is_valid() const { return size() != 0; }
+    API_NO_DISCARD bool is_signed() const {
+      return signature_info().signature().is_valid();
+    }
+
+  private:
+    // hash of the entire image
+    API_AC(Entry, crypto::Sha256::Hash, hash);
+    API_AF(Entry, u32, size, 0);
+    // the value at BOOTLOADER_HARDWARE_ID_OFFSET for OS images
+    API_AF(Entry, u32, hardware_id, 0);
+    // the signature plus the hash and size of the image without the
+    // marker -- for images that aren't signed, the signature is
+    // invalid and the size is the size of the image
+    API_AC(Entry, Auth::SignatureInfo, signature_info);
+  };
+
+  explicit ImageStore(var::StringView path);
+  ~ImageStore();
+
+  ImageStore(const ImageStore &a) = delete;
+  ImageStore &operator=(const ImageStore &a) = delete;
+
+  // the file is only read if it changed since it was last added
+  Entry get(var::StringView image_path);
+
+  API_NO_DISCARD Entry find(const crypto::Sha256::Hash &hash) const;
+
+  ImageStore &save();
+
+  API_NO_DISCARD const var::PathString &path() const { return m_path; }
+
+private:
+  static constexpr u32 file_version = 2;
+  static constexpr size_t path_capacity = 256;
+
+  struct Record {
+    char path[path_capacity];
+    // nanoseconds since the epoch
+    u64 modification_time;
+    u32 size;
+    u32 hardware_id;
+    u8 hash[32];
+    u32 signed_size;
+    u8 signed_hash[32];
+    u8 signature[64];
+  };
+
+  var::PathString m_path;
+  var::Vector<Record> m_record_list;
+  bool m_is_dirty = false;
+
+  static Entry get_entry(const Record &record);
+  static Record get_record(var::StringView image_path);
+};
+
+} // namespace sos
+
+#endif // link and crypto
+
+#endif // SOSAPI_SOS_IMAGESTORE_HPP
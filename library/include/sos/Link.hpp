@@ -7,6 +7,8 @@
 
 #if defined __link
 
+#include <utility>
+
 #include <sdk/types.h>
 #include <sos/link.h>
 
@@ -15,6 +17,7 @@
 #include <fs/Dir.hpp>
 #include <fs/FileSystem.hpp>
 #include <printer/Printer.hpp>
+#include <var/Data.hpp>
 #include <var/String.hpp>
 #include <var/Tokenizer.hpp>
 #include <var/Vector.hpp>
@@ -23,6 +26,8 @@
 
 namespace sos {
 
+class ImageStore;
+
 class Link : public api::ExecutionContext {
 public:
   enum class Type { null, serial, usb };
@@ -190,6 +195,68 @@ public:
     var::String lookup_serial_port_path_from_usb_details();
   };
 
+  /*
+   * Persistent record of the devices that have been seen
+   * and the path they were last connected on.
+   *
+   * Entries are keyed by serial number. The cache is loaded
+   * when constructed and saved when destroyed (if it changed).
+   * It is not thread safe.
+   */
+  class InfoCache : public api::ExecutionContext {
+  public:
+    class Entry {
+    public:
+      API_NO_DISCARD bool is_valid() const {
+        return info().serial_number().is_valid();
+      }
+
+    private:
+      API_AC(Entry, Info, info);
+      // seconds since the epoch
+      API_AF(Entry, u32, last_seen, 0);
+      // how long the last erase_os() took (zero if unknown)
+      API_AC(Entry, chrono::MicroTime, erase_duration);
+    };
+
+    using EntryList = var::Vector<Entry>;
+
+    explicit InfoCache(var::StringView path);
+    ~InfoCache();
+
+    InfoCache(const InfoCache &a) = delete;
+    InfoCache &operator=(const InfoCache &a) = delete;
+
+    API_NO_DISCARD Entry find(const SerialNumber &serial_number) const;
+
+    InfoCache &update(const Info &info);
+    InfoCache &update_erase_duration(
+      const SerialNumber &serial_number,
+      const chrono::MicroTime &duration);
+    InfoCache &remove(const SerialNumber &serial_number);
+    InfoCache &save();
+
+    API_NO_DISCARD const EntryList &entry_list() const { return m_entry_list; }
+    API_NO_DISCARD const var::PathString &path() const { return m_path; }
+
+  private:
+    static constexpr u32 file_version = 2;
+    static constexpr size_t path_capacity = 256;
+
+    struct Record {
+      char path[path_capacity];
+      sys_info_t sys_info;
+      u32 last_seen;
+      u32 erase_milliseconds;
+    };
+
+    var::PathString m_path;
+    EntryList m_entry_list;
+    bool m_is_dirty = false;
+
+    API_NO_DISCARD int find_offset(const SerialNumber &serial_number) const;
+  };
+
   Link();
   ~Link();
 
@@ -198,9 +265,60 @@ public:
   using InfoList = var::Vector<Info>;
   InfoList get_info_list();
 
+  class GetInfoList {
+    // each worker probes paths using its own copy of driver()
+    API_AF(GetInfoList, u32, thread_count, 8);
+  };
+
+  InfoList get_info_list(const GetInfoList &options);
+  inline InfoList operator()(const GetInfoList &options) {
+    return get_info_list(options);
+  }
+
   Link &connect(var::StringView path, IsLegacy is_legacy = IsLegacy::no);
+  // uses info_cache() (if set) before scanning all paths
+  Link &connect(
+    const SerialNumber &serial_number,
+    IsLegacy is_legacy = IsLegacy::no);
   API_NO_DISCARD bool is_legacy() const { return m_is_legacy == IsLegacy::yes; }
   Link &reconnect(int retries = 5, chrono::MicroTime delay = 500_milliseconds);
+
+  class Reconnect {
+  public:
+    Reconnect()
+      : m_timeout(2500_milliseconds), m_initial_delay(10_milliseconds),
+        m_maximum_delay(500_milliseconds) {}
+
+  private:
+    // total time allowed for the device to show up again
+    API_AC(Reconnect, chrono::MicroTime, timeout);
+    // delay between scans doubles from initial_delay up to maximum_delay
+    API_AC(Reconnect, chrono::MicroTime, initial_delay);
+    API_AC(Reconnect, chrono::MicroTime, maximum_delay);
+    // each delay is randomly adjusted by up to this percentage (max 100)
+    API_AF(Reconnect, u32, jitter_percent, 20);
+    // scan at least this many times even if the timeout has elapsed
+    API_AF(Reconnect, u32, minimum_scan_count, 0);
+  };
+
+  // time spent in each phase of the last reconnect()
+  class ReconnectReport {
+    API_AC(ReconnectReport, chrono::MicroTime, last_path_duration);
+    API_AC(ReconnectReport, chrono::MicroTime, scan_duration);
+    API_AC(ReconnectReport, chrono::MicroTime, probe_duration);
+    API_AC(ReconnectReport, chrono::MicroTime, wait_duration);
+    API_AF(ReconnectReport, u32, scan_count, 0);
+    API_AF(ReconnectReport, u32, probe_count, 0);
+  };
+
+  Link &reconnect(const Reconnect &options);
+  inline Link &operator()(const Reconnect &options) {
+    return reconnect(options);
+  }
+
+  API_NO_DISCARD const ReconnectReport &reconnect_report() const {
+    return m_reconnect_report;
+  }
   Link &disconnect();
   Link &disregard_connection();
 
@@ -232,11 +350,101 @@ public:
   Link &set_time(struct tm *gt);
 
   class UpdateOs {
+  public:
+    enum chunk_sizes {
+      minimum_chunk_size = 256,
+      maximum_chunk_size = 16384
+    };
+
+  private:
     API_AF(UpdateOs, const fs::FileObject *, image, nullptr);
     API_AF(UpdateOs, u32, bootloader_retry_count, 20);
     API_AF(UpdateOs, printer::Printer *, printer, nullptr);
+    // used in place of printer()->progress_callback() if not null
+    API_AF(UpdateOs, const api::ProgressCallback *, progress_callback, nullptr);
     API_AB(UpdateOs, verify, false);
+    // when verifying, read back 1 of every `verify_interval` chunks
+    // (the first and last chunks are always read back)
+    API_AF(UpdateOs, u32, verify_interval, 1);
+    // only rewrite flash that differs from the image -- ignored
+    // when the device requires a signature. With the bootloader, pages
+    // that need an erase (or the start page) cause a full install.
+    API_AB(UpdateOs, delta, false);
     API_AC(UpdateOs, var::PathString, flash_path);
+    // records install progress so an interrupted install can resume
+    API_AC(UpdateOs, var::PathString, journal_path);
+    // bytes sent to the bootloader per write, rounded down to a multiple
+    // of minimum_chunk_size and limited to maximum_chunk_size
+    API_AF(UpdateOs, u32, chunk_size, 1024);
+    // starting at chunk_size, grow the chunk size while throughput improves
+    API_AB(UpdateOs, adaptive_chunk_size, false);
+    // don't send chunks that are all 0xff (the erased state)
+    API_AB(UpdateOs, sparse, false);
+    // an image that is already in memory (like MappedImage::view())
+    // is used in place of image() and isn't copied
+    API_AC(UpdateOs, var::View, image_view);
+    // SHA-256 of the image if already known (see ImageStore) so the
+    // journal doesn't need to hash the image again
+    API_AC(UpdateOs, var::View, image_hash);
+    // with image_hash(), the image's entry provides whether it is
+    // signed, so an image that the bootloader will reject fails before
+    // the OS is erased. The image is hashed to check that the entry is
+    // for this image (needs the crypto API).
+    API_AF(UpdateOs, const ImageStore *, image_store, nullptr);
+  };
+
+  /*! \details The MappedImage class maps an image file
+   * into memory as read-only so that it can be passed to
+   * UpdateOs::set_image_view() without being copied.
+   *
+   */
+  class MappedImage : public api::ExecutionContext {
+  public:
+    MappedImage() = default;
+    explicit MappedImage(var::StringView path);
+    ~MappedImage();
+
+    MappedImage(const MappedImage &a) = delete;
+    MappedImage &operator=(const MappedImage &a) = delete;
+
+    MappedImage(MappedImage &&a) { swap(a); }
+    MappedImage &operator=(MappedImage &&a) {
+      swap(a);
+      return *this;
+    }
+
+    API_NO_DISCARD var::View view() const { return var::View(m_data, m_size); }
+
+  private:
+    const void *m_data = nullptr;
+    size_t m_size = 0;
+#if defined __win32
+    // windows builds read the file into memory
+    var::Data m_file_data;
+#endif
+
+    void swap(MappedImage &a) {
+      std::swap(m_data, a.m_data);
+      std::swap(m_size, a.m_size);
+#if defined __win32
+      std::swap(m_file_data, a.m_file_data);
+#endif
+    }
+  };
+
+  // transfer statistics from the last update_os()
+  class UpdateReport {
+    API_AC(UpdateReport, chrono::MicroTime, erase_duration);
+    API_AC(UpdateReport, chrono::MicroTime, write_duration);
+    API_AC(UpdateReport, chrono::MicroTime, verify_duration);
+    // the chunk size used for the last write
+    API_AF(UpdateReport, u32, chunk_size, 0);
+    API_AF(UpdateReport, u32, write_count, 0);
+    // bytes that were already in the erased state and weren't sent
+    API_AF(UpdateReport, u32, skipped_size, 0);
+    API_AF(UpdateReport, u32, bytes_per_second, 0);
+    // where a journaled install picked up (0 if it started over)
+    API_AF(UpdateReport, u32, resume_offset, 0);
   };
 
   Link &update_os(const UpdateOs &options);
@@ -244,6 +452,89 @@ public:
     return update_os(options);
   }
 
+  API_NO_DISCARD const UpdateReport &update_report() const {
+    return m_update_report;
+  }
+
+  // copies flash from a device in the bootloader to a file
+  class DumpFlash {
+  private:
+    API_AF(DumpFlash, u32, address, 0);
+    API_AF(DumpFlash, u32, size, 0);
+    API_AF(DumpFlash, const fs::FileObject *, file, nullptr);
+    // bytes requested from the bootloader per read, rounded down to a
+    // multiple of page_size and limited to UpdateOs::maximum_chunk_size
+    API_AF(DumpFlash, u32, chunk_size, 4096);
+    // erased pages and manifest lines are tracked per page
+    API_AF(DumpFlash, u32, page_size, 256);
+    // seek past pages that are all 0xff rather than writing them so
+    // file systems that support holes don't store them -- holes read
+    // back as 0x00 so use the manifest to tell them apart
+    API_AB(DumpFlash, sparse, false);
+    // if not null, gets a `#` comment header then one line per page:
+    // `<address> <hash|erased>`, the hash is sha256 (or crc32 without
+    // the crypto API)
+    API_AF(DumpFlash, const fs::FileObject *, manifest, nullptr);
+    API_AF(DumpFlash, printer::Printer *, printer, nullptr);
+    // used in place of printer()->progress_callback() if not null
+    API_AF(DumpFlash, const api::ProgressCallback *, progress_callback, nullptr);
+  };
+
+  Link &dump_flash(const DumpFlash &options);
+  inline Link &operator()(const DumpFlash &options) {
+    return dump_flash(options);
+  }
+
+  // compares the OS flash of a device in the bootloader with an image
+  class CompareFlash {
+  private:
+    API_AF(CompareFlash, const fs::FileObject *, image, nullptr);
+    // used in place of image() and isn't copied
+    API_AC(CompareFlash, var::View, image_view);
+    // 1 compares every page (strict), otherwise 1 of every
+    // `sample_interval` pages is compared (the first and last pages
+    // are always compared)
+    API_AF(CompareFlash, u32, sample_interval, 1);
+    API_AF(CompareFlash, u32, page_size, 256);
+    // stop reading at the first page that differs
+    API_AB(CompareFlash, stop_at_mismatch, false);
+    // the report is printed as object `compare` if not null
+    API_AF(CompareFlash, printer::Printer *, printer, nullptr);
+    // used in place of printer()->progress_callback() if not null
+    API_AF(
+      CompareFlash,
+      const api::ProgressCallback *,
+      progress_callback,
+      nullptr);
+  };
+
+  // results of the last compare_flash()
+  class CompareReport {
+  public:
+    API_NO_DISCARD bool is_strict() const { return sample_interval() <= 1; }
+    API_NO_DISCARD bool is_match() const {
+      return page_count() && mismatch_list().count() == 0;
+    }
+
+  private:
+    API_AF(CompareReport, u32, address, 0);
+    API_AF(CompareReport, u32, page_size, 0);
+    API_AF(CompareReport, u32, sample_interval, 1);
+    API_AF(CompareReport, u32, page_count, 0);
+    API_AF(CompareReport, u32, compared_page_count, 0);
+    // the address of each page that differs from the image
+    API_AC(CompareReport, var::Vector<u32>, mismatch_list);
+  };
+
+  Link &compare_flash(const CompareFlash &options);
+  inline Link &operator()(const CompareFlash &options) {
+    return compare_flash(options);
+  }
+
+  API_NO_DISCARD const CompareReport &compare_report() const {
+    return m_compare_report;
+  }
+
   API_NO_DISCARD const link_transport_mdriver_t *driver() const { return &m_driver_instance; }
   link_transport_mdriver_t *driver() { return &m_driver_instance; }
 
@@ -450,12 +741,54 @@ public:
 private:
   enum class Connection { null, bootloader, os };
 
+  /*
+   * Records how much of an image has been written to a device.
+   * Records are keyed by serial number and image hash. The file is
+   * written each time a record changes.
+   */
+  class InstallJournal : public api::ExecutionContext {
+  public:
+    // image_hash is computed from image if it is empty
+    InstallJournal(
+      var::StringView path,
+      const SerialNumber &serial_number,
+      var::View image,
+      var::View image_hash = var::View());
+
+    // bytes written to the device, 0 if there is no record
+    API_NO_DISCARD u32 size() const { return m_record.size; }
+    InstallJournal &set_size(u32 value);
+    InstallJournal &remove();
+
+  private:
+    static constexpr u32 file_version = 1;
+
+    struct Record {
+      u32 serial_number[4];
+      u8 hash[32];
+      u32 size;
+    };
+
+    var::PathString m_path;
+    Record m_record = {};
+    // records for other devices
+    var::Vector<Record> m_record_list;
+
+    void save();
+  };
+
   volatile int m_progress = 0;
   volatile int m_progress_max = 0;
   IsBootloader m_is_bootloader = IsBootloader::no;
   IsLegacy m_is_legacy = IsLegacy::no;
 
   Info m_link_info;
+  ReconnectReport m_reconnect_report;
+  UpdateReport m_update_report;
+  CompareReport m_compare_report;
+  // duration of the last erase_os() if there is no info_cache()
+  chrono::MicroTime m_erase_duration;
+  API_AF(Link, InfoCache *, info_cache, nullptr);
 
   bootloader_attr_t m_bootloader_attributes = {};
   link_transport_mdriver_t m_driver_instance = {};
@@ -463,21 +796,59 @@ private:
   enum class UseBootloaderId { no, yes };
 
   u32 validate_os_image_id_with_connected_bootloader(
-    const fs::FileObject *source_image,
+    var::View image,
     UseBootloaderId bootloader_id = UseBootloaderId::yes);
 
+  // reads the OS flash at `offset` from the start address, protocol
+  // errors are retried -- returns the result of link_readflash()
+  int read_os_flash(u32 offset, var::View destination);
+  // what install_os() leaves in flash for `size` bytes of `image` at
+  // `offset` -- `buffer` is used if the hardware id is corrected
+  API_NO_DISCARD var::View get_installed_os_view(
+    u32 image_id,
+    var::View image,
+    u32 offset,
+    u32 size,
+    var::Data &buffer) const;
+
   // these use the bootloader
   Link &erase_os(const UpdateOs &options);
-  Link &install_os(u32 image_id, const UpdateOs &options);
+  Link &install_os(
+    u32 image_id,
+    var::View image,
+    const UpdateOs &options,
+    u32 resume_offset = 0,
+    InstallJournal *journal = nullptr);
+  // rewrites pages that differ in place -- false if a full install is needed
+  bool install_os_delta(u32 image_id, var::View image, const UpdateOs &options);
+  u32 get_install_resume_offset(
+    var::View image,
+    const UpdateOs &options,
+    const InstallJournal &journal);
 
   // these use a bootloader running a full Stratify OS instance
-  void update_os_flash_device(const UpdateOs &options);
-  void erase_os_flash_device(const UpdateOs &options, const File &flash_device);
-  void
-  install_os_flash_device(const UpdateOs &options, const File &flash_device);
+  void update_os_flash_device(var::View image, const UpdateOs &options);
+  void erase_os_flash_device(
+    var::View image,
+    const UpdateOs &options,
+    const File &flash_device);
+  void install_os_flash_device(
+    var::View image,
+    const UpdateOs &options,
+    const File &flash_device);
+  void install_os_flash_device_delta(
+    var::View image,
+    const UpdateOs &options,
+    const File &flash_device);
 
   Link &reset_progress();
   Connection ping_connection(var::StringView path);
+  bool connect_serial_number(
+    var::StringView path,
+    const SerialNumber &serial_number,
+    IsLegacy is_legacy = IsLegacy::no);
+
+  static void *get_info_list_worker(void *args);
 
   static var::NumberString get_device_result_error(s32 result);
 };
@@ -488,6 +859,9 @@ namespace printer {
 class Printer;
 Printer &operator<<(Printer &printer, const sos::Link::Info &a);
 Printer &operator<<(Printer &printer, const sos::Link::InfoList &a);
+Printer &operator<<(Printer &printer, const sos::Link::ReconnectReport &a);
+Printer &operator<<(Printer &printer, const sos::Link::UpdateReport &a);
+Printer &operator<<(Printer &printer, const sos::Link::CompareReport &a);
 } // namespace printer
 
 #endif // link
@@ -0,0 +1,101 @@
+// Copyright 2016-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SOSAPI_SOS_LINKASYNC_HPP
+#define SOSAPI_SOS_LINKASYNC_HPP
+
+#include "macros.hpp"
+
+#if defined __link
+
+#include "LinkPool.hpp"
+
+namespace sos {
+
+/*! \brief LinkAsync Class
+ * \details The LinkAsync class provides non-blocking
+ * versions of the Link operations for one device in a LinkPool.
+ *
+ * Each method queues the operation on the device's worker and
+ * returns immediately with a LinkPool::Future. A single thread
+ * can keep many devices busy by starting operations on several
+ * LinkAsync objects and then waiting on the futures.
+ *
+ * connect() and disconnect() take over the connection from the
+ * pool: after disconnect(), later operations fail until connect()
+ * succeeds. Paths longer than `LINK_PATH_MAX - 1` are rejected
+ * with `ENAMETOOLONG` and an invalid Future is returned.
+ *
+ * Data that is written is copied when the operation is queued.
+ * Destinations for data that is read must remain valid until
+ * the Future is complete. For file reads and writes,
+ * Result::value() is the number of bytes transferred.
+ *
+ * ```cpp
+ * LinkPool::FutureList future_list;
+ * for (size_t i = 0; i < pool.count(); i++) {
+ *   future_list.push_back(LinkAsync(pool, i).format("/home"));
+ * }
+ * const auto result_list = LinkPool::wait(future_list);
+ * ```
+ *
+ */
+class LinkAsync : public api::ExecutionContext {
+public:
+  using Future = LinkPool::Future;
+
+  LinkAsync(LinkPool &pool, size_t device_index)
+    : m_pool(&pool), m_device_index(device_index) {}
+
+  // disconnects (if needed) then connects to `path`
+  Future connect(
+    var::StringView path,
+    Link::IsLegacy is_legacy = Link::IsLegacy::no);
+  Future disconnect();
+
+  Future read_flash(int address, var::View destination);
+  Future write_flash(int address, var::View source);
+
+  Future get_time(struct tm *destination);
+  Future run_app(var::StringView path);
+  Future format(var::StringView path);
+
+  Future read_file(var::StringView path, int offset, var::View destination);
+  // the file must already exist
+  Future write_file(var::StringView path, int offset, var::View source);
+
+  // queues any other operation on the device
+  Future
+  submit(LinkPool::function_t function, var::View argument = var::View()) {
+    return m_pool->submit(m_device_index, function, argument);
+  }
+
+private:
+  LinkPool *m_pool;
+  size_t m_device_index;
+
+  struct PathArgument {
+    char path[LINK_PATH_MAX];
+    Link::IsLegacy is_legacy;
+  };
+
+  struct MemoryArgument {
+    char path[LINK_PATH_MAX];
+    int offset;
+    void *destination;
+    int size;
+    // data that is written follows the argument
+  };
+
+  PathArgument get_path_argument(var::StringView path);
+  var::Data get_memory_argument(
+    var::StringView path,
+    int offset,
+    void *destination,
+    var::View source);
+};
+
+} // namespace sos
+
+#endif // link
+
+#endif // SOSAPI_SOS_LINKASYNC_HPP
@@ -0,0 +1,136 @@
+// Copyright 2016-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SOSAPI_SOS_LINKMONITOR_HPP
+#define SOSAPI_SOS_LINKMONITOR_HPP
+
+#include "macros.hpp"
+
+#if defined __link
+
+#include <chrono/MicroTime.hpp>
+#include <thread/Cond.hpp>
+#include <thread/Mutex.hpp>
+#include <thread/Thread.hpp>
+
+#include "Link.hpp"
+
+namespace sos {
+
+/*! \brief LinkMonitor Class
+ * \details The LinkMonitor class watches the driver's
+ * path enumeration on a background thread and reports
+ * devices as they are attached and detached.
+ *
+ * New paths are probed to resolve their Link::Info. A path
+ * that doesn't respond is probed again no sooner than
+ * `probe_interval`.
+ *
+ * Events are delivered to `callback` (on the monitor thread)
+ * if one is provided. Otherwise, they are queued and
+ * can be read using get_event() or wait_event(). If the queue
+ * holds `maximum_event_count` events, the oldest event is dropped
+ * to make room (see dropped_event_count()).
+ *
+ * ```cpp
+ * LinkMonitor monitor(LinkMonitor::Construct());
+ * while (true) {
+ *   const auto event = monitor.wait_event();
+ *   printer.key_bool("attached", event.is_attached());
+ *   printer.object("info", event.info());
+ * }
+ * ```
+ *
+ */
+class LinkMonitor : public api::ExecutionContext {
+public:
+  enum class Type { null, attached, detached };
+
+  class Event {
+  public:
+    API_NO_DISCARD bool is_valid() const { return type() != Type::null; }
+    API_NO_DISCARD bool is_attached() const { return type() == Type::attached; }
+    API_NO_DISCARD bool is_detached() const { return type() == Type::detached; }
+
+  private:
+    API_AF(Event, Type, type, Type::null);
+    // for detached events, this is the info from when the device was attached
+    API_AC(Event, Link::Info, info);
+  };
+
+  using callback_t = void (*)(const Event &event, void *context);
+
+  // paths that appeared and disappeared between two enumerations
+  class PathDiff {
+    API_AC(PathDiff, fs::PathList, added_list);
+    API_AC(PathDiff, fs::PathList, removed_list);
+  };
+
+  class Construct {
+  public:
+    Construct()
+      : m_interval(250_milliseconds), m_probe_interval(1000_milliseconds) {}
+
+  private:
+    // copied by the monitor, the default driver is used if null
+    API_AF(Construct, link_transport_mdriver_t *, driver, nullptr);
+    // time between path enumerations
+    API_AC(Construct, chrono::MicroTime, interval);
+    // minimum time between probes of a path that didn't respond
+    API_AC(Construct, chrono::MicroTime, probe_interval);
+    API_AF(Construct, callback_t, callback, nullptr);
+    API_AF(Construct, void *, context, nullptr);
+    // events queued when there is no callback (must be at least 1)
+    API_AF(Construct, u32, maximum_event_count, 64);
+  };
+
+  explicit LinkMonitor(const Construct &options);
+  ~LinkMonitor();
+
+  LinkMonitor(const LinkMonitor &a) = delete;
+  LinkMonitor &operator=(const LinkMonitor &a) = delete;
+
+  // returns an invalid event if none are queued
+  Event get_event();
+
+  // blocks until an event is queued or the monitor is destroyed
+  Event wait_event();
+
+  // devices that are currently attached
+  API_NO_DISCARD Link::InfoList get_info_list();
+
+  // events dropped because the queue was full
+  API_NO_DISCARD u32 dropped_event_count();
+
+  static PathDiff
+  get_path_diff(const fs::PathList &previous, const fs::PathList &current);
+
+private:
+  struct Entry {
+    var::PathString path;
+    Link::Info info;
+    bool is_attached = false;
+    bool is_probed = false;
+    u64 probe_timestamp = 0;
+  };
+
+  Construct m_construct;
+  thread::Mutex m_mutex;
+  thread::Cond m_event_cond;
+  var::Vector<Event> m_event_list;
+  var::Vector<Entry> m_entry_list;
+  u32 m_dropped_event_count = 0;
+  bool m_is_stop = false;
+  Link m_link;
+  thread::Thread m_thread;
+
+  static void *monitor_function(void *args);
+  void run_monitor();
+  void emit(const Event &event);
+  API_NO_DISCARD bool is_stop();
+};
+
+} // namespace sos
+
+#endif // link
+
+#endif // SOSAPI_SOS_LINKMONITOR_HPP
@@ -0,0 +1,176 @@
+// Copyright 2016-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SOSAPI_SOS_LINKPOOL_HPP
+#define SOSAPI_SOS_LINKPOOL_HPP
+
+#include "macros.hpp"
+
+#if defined __link
+
+#include <memory>
+
+#include <chrono/MicroTime.hpp>
+#include <thread/Cond.hpp>
+#include <thread/Mutex.hpp>
+#include <thread/Thread.hpp>
+#include <var/Data.hpp>
+#include <var/String.hpp>
+
+#include "Link.hpp"
+
+namespace sos {
+
+/*! \brief LinkPool Class
+ * \details The LinkPool class owns one Link per device. Each
+ * Link is driven by a dedicated worker thread with its own
+ * queue so operations on different devices run concurrently.
+ *
+ * Operations are submitted as a function that receives the
+ * device's Link and a copy of the submitted argument. If the
+ * Link isn't connected when an operation starts, the worker
+ * connects to the device's path first. Operations submitted with
+ * `IsAutoConnect::no` manage the connection themselves. If one of
+ * them leaves the Link disconnected, the worker stops connecting
+ * automatically until one leaves it connected again. Errors that
+ * are left on the worker thread are captured in the Result.
+ *
+ * Each Future has an id that is unique per device. The pool keeps
+ * the Result for an id until it is retrieved with Future::get() (or
+ * wait()) and then releases it. Getting the same Future again
+ * returns a Result with `ENOENT`. Results that are never retrieved
+ * are kept until the pool is destroyed.
+ *
+ * ```cpp
+ * Link link;
+ * LinkPool pool(LinkPool::Construct().set_info_list(link.get_info_list()));
+ *
+ * const auto result_list = LinkPool::wait(pool.submit_all(
+ *   [](Link &link, void *) { link.reset().reconnect(); }));
+ * ```
+ *
+ */
+class LinkPool : public api::ExecutionContext {
+public:
+  using function_t = void (*)(Link &link, void *argument);
+
+  enum class IsAutoConnect { no, yes };
+
+  class Construct {
+    API_AC(Construct, Link::InfoList, info_list);
+    // copied by each worker, the default driver is used if null
+    API_AF(Construct, link_transport_mdriver_t *, driver, nullptr);
+  };
+
+  class Result {
+  public:
+    API_NO_DISCARD bool is_success() const { return error_number() == 0; }
+
+  private:
+    API_AB(Result, complete, false);
+    API_AF(Result, int, error_number, 0);
+    // return_value() on the worker thread when the operation finished
+    API_AF(Result, int, value, 0);
+    API_AC(Result, var::GeneralString, error_message);
+    API_AC(Result, chrono::MicroTime, duration);
+  };
+
+  using ResultList = var::Vector<Result>;
+
+  class Future {
+  public:
+    Future() = default;
+
+    API_NO_DISCARD bool is_valid() const { return m_pool != nullptr; }
+    API_NO_DISCARD bool is_ready() const;
+    API_NO_DISCARD size_t device_index() const { return m_device_index; }
+
+    // blocks until the operation is complete
+    API_NO_DISCARD Result get() const;
+
+  private:
+    friend class LinkPool;
+    Future(LinkPool *pool, size_t device_index, u32 id)
+      : m_pool(pool), m_device_index(device_index), m_id(id) {}
+
+    LinkPool *m_pool = nullptr;
+    size_t m_device_index = 0;
+    u32 m_id = 0;
+  };
+
+  using FutureList = var::Vector<Future>;
+
+  explicit LinkPool(const Construct &options);
+  ~LinkPool();
+
+  LinkPool(const LinkPool &a) = delete;
+  LinkPool &operator=(const LinkPool &a) = delete;
+
+  API_NO_DISCARD size_t count() const { return m_worker_list.count(); }
+  API_NO_DISCARD const Link::Info &info(size_t device_index) const {
+    return m_worker_list.at(device_index)->info;
+  }
+
+  // the pool must outlive the returned Future, the result
+  // can be retrieved once
+  Future submit(
+    size_t device_index,
+    function_t function,
+    var::View argument = var::View(),
+    IsAutoConnect is_auto_connect = IsAutoConnect::yes);
+
+  FutureList submit_all(function_t function, var::View argument = var::View());
+
+  static ResultList wait(const FutureList &future_list);
+
+private:
+  struct Job {
+    u32 id = 0;
+    function_t function = nullptr;
+    var::Data argument;
+    IsAutoConnect is_auto_connect = IsAutoConnect::yes;
+  };
+
+  struct ResultEntry {
+    u32 id = 0;
+    Result result;
+  };
+
+  struct Worker {
+    Worker(LinkPool *pool, thread::Mutex &mutex) : pool(pool), cond(mutex) {}
+    LinkPool *pool;
+    Link::Info info;
+    Link link;
+    thread::Cond cond;
+    // pending jobs in the order submitted
+    var::Vector<Job> job_list;
+    // results that haven't been retrieved yet
+    var::Vector<ResultEntry> result_list;
+    u32 next_id = 0;
+    // only accessed by the worker thread
+    bool is_auto_connect = true;
+    thread::Thread thread;
+  };
+
+  thread::Mutex m_mutex;
+  thread::Cond m_complete_cond;
+  var::Vector<std::unique_ptr<Worker>> m_worker_list;
+  bool m_is_stop = false;
+
+  static void *worker_function(void *args);
+  void run_worker(Worker &worker);
+  API_NO_DISCARD static size_t
+  find_result_offset(const Worker &worker, u32 id);
+  API_NO_DISCARD bool is_complete(size_t device_index, u32 id);
+  Result wait_result(size_t device_index, u32 id);
+};
+
+} // namespace sos
+
+namespace printer {
+class Printer;
+Printer &operator<<(Printer &printer, const sos::LinkPool::Result &a);
+} // namespace printer
+
+#endif // link
+
+#endif // SOSAPI_SOS_LINKPOOL_HPP
@@ -0,0 +1,121 @@
+// Copyright 2016-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SOSAPI_SOS_LINKUPDATER_HPP
+#define SOSAPI_SOS_LINKUPDATER_HPP
+
+#include "macros.hpp"
+
+#if defined __link
+
+#include <memory>
+
+#include <printer/Printer.hpp>
+#include <thread/Cond.hpp>
+#include <thread/Mutex.hpp>
+
+#include "LinkPool.hpp"
+
+namespace sos {
+
+/*! \brief LinkUpdater Class
+ * \details The LinkUpdater class installs one OS image
+ * on every device in a LinkPool at the same time.
+ *
+ * The image is checked once and the same view is used
+ * by every device so nothing is copied per device. Devices
+ * running the OS are reset to the bootloader first.
+ *
+ * A group is assigned to each device using `group_function`
+ * (for example, the USB hub the device is attached to). No more
+ * than `group_concurrency` devices in a group are updated at once.
+ * If no function is provided, all devices are in the same group.
+ *
+ * ```cpp
+ * const Link::MappedImage image("os.bin");
+ * LinkPool pool(LinkPool::Construct().set_info_list(link.get_info_list()));
+ * const auto result_list = LinkUpdater(pool).update(
+ *   LinkUpdater::Update()
+ *     .set_image(image.view())
+ *     .set_group_concurrency(8)
+ *     .set_printer(&printer));
+ * ```
+ *
+ */
+class LinkUpdater : public api::ExecutionContext {
+public:
+  using group_function_t = u32 (*)(const Link::Info &info, void *context);
+
+  class Update {
+  public:
+    Update() : m_poll_interval(100_milliseconds) {}
+
+  private:
+    // must remain valid until update() returns
+    API_AC(Update, var::View, image);
+    API_AB(Update, verify, false);
+    API_AF(Update, u32, verify_interval, 1);
+    API_AF(Update, u32, chunk_size, 1024);
+    API_AF(Update, u32, bootloader_retry_count, 20);
+    // 0 means no limit
+    API_AF(Update, u32, group_concurrency, 0);
+    API_AF(Update, group_function_t, group_function, nullptr);
+    API_AF(Update, void *, group_context, nullptr);
+    // shows the progress of all devices combined
+    API_AF(Update, printer::Printer *, printer, nullptr);
+    API_AC(Update, chrono::MicroTime, poll_interval);
+  };
+
+  explicit LinkUpdater(LinkPool &pool)
+    : m_pool(&pool), m_group_cond(m_mutex) {}
+
+  LinkUpdater(const LinkUpdater &a) = delete;
+  LinkUpdater &operator=(const LinkUpdater &a) = delete;
+
+  // blocks until every device is updated, the results are in device order
+  LinkPool::ResultList update(const Update &options);
+
+  // progress of the devices combined while update() is running
+  API_NO_DISCARD int progress();
+  API_NO_DISCARD int progress_max();
+
+private:
+  struct Device {
+    explicit Device(LinkUpdater *updater) : updater(updater) {}
+    LinkUpdater *updater;
+    size_t device_index = 0;
+    u32 group = 0;
+    int progress = 0;
+    int progress_max = 0;
+    // the device's update output isn't shown
+    printer::Printer printer;
+    api::ProgressCallback progress_callback;
+  };
+
+  struct DeviceArgument {
+    Device *device;
+  };
+
+  struct Group {
+    u32 id = 0;
+    u32 active_count = 0;
+  };
+
+  LinkPool *m_pool;
+  const Update *m_update = nullptr;
+  u32 m_image_id = 0;
+  thread::Mutex m_mutex;
+  thread::Cond m_group_cond;
+  var::Vector<std::unique_ptr<Device>> m_device_list;
+  var::Vector<Group> m_group_list;
+
+  static void update_function(Link &link, void *argument);
+  static bool update_progress(void *context, int progress, int total);
+  void run_update(Link &link, Device &device);
+  Group &get_group(u32 id);
+};
+
+} // namespace sos
+
+#endif // link
+
+#endif // SOSAPI_SOS_LINKUPDATER_HPP
@@ -147,6 +147,8 @@ Appfs::Appfs(const Construct &options FSAPI_LINK_DECLARE_DRIVER_LAST)
     m_bytes_written = 0;
     m_data_size = 0;
     m_request = I_APPFS_INSTALL;
+    // the device installs the app using the name in the header
+    m_name = var::NameString(fs::Path::name(options.name()));
   } else {
     m_request = 0;
   }
@@ -158,48 +160,152 @@ Appfs &Appfs::append(
   API_RETURN_VALUE_IF_ERROR(*this);
 
   API_ASSERT(m_request != 0);
+  if (m_is_aborted) {
+    API_RETURN_VALUE_ASSIGN_ERROR(*this, "append was aborted", EINVAL);
+  }
+
+  const bool is_install = m_request == I_APPFS_INSTALL;
+
 #if SOS_API_USE_CRYPTO_API
-  const auto signature = Auth::get_signature(file);
-  const auto is_signature_required = [&]() {
+  // the trailing signature marker of an install is held back until
+  // the end of the input is found unless the signature is known
+  const bool is_signature_known = is_install && m_signature_info.size();
+  const size_t marker_size
+    = is_install && !is_signature_known ? Auth::signature_marker_size : 0;
+#else
+  constexpr size_t marker_size = 0;
+#endif
+
+  // the size of an install is found by streaming the input once
+  // so sources that can't seek (like pipes) work too
+  const bool is_size_known = is_install == false || m_data_size != 0;
+  if (is_size_known == false) {
+    m_data_size = static_cast<u32>(-1);
+  }
+
+  const size_t progress_size = [&]() -> size_t {
+    if (is_install == false) {
+      return m_data_size - overhead();
+    }
     api::ErrorScope error_scope;
-    return m_file.ioctl(I_APPFS_IS_SIGNATURE_REQUIRED).return_value() == 1;
+    const size_t result = file.size();
+    return is_error() ? 0 : result;
   }();
+  const int progress_total
+    = progress_size ? static_cast<int>(progress_size)
+                    : api::ProgressCallback::indeterminate_progress_total();
+
+  size_t bytes_read = 0;
+  // input past this size isn't installed
+  size_t input_size = static_cast<size_t>(-1);
+#if SOS_API_USE_CRYPTO_API
+  auto signature = crypto::Dsa::Signature();
+  bool is_signature_required = false;
+  if (is_signature_known && m_signature_info.signature().is_valid()) {
+    is_signature_required = Appfs::is_signature_required();
+    if (is_signature_required) {
+      // a required signature isn't part of the installed image
+      signature = m_signature_info.signature();
+      input_size = m_signature_info.size();
+    }
+  }
 #else
   constexpr auto is_signature_required = false;
 #endif
 
-  if (m_data_size == 0 && m_request == I_APPFS_INSTALL) {
-    const auto file_size = file.size();
-    if (is_signature_required) {
-      m_data_size = file_size - sizeof(auth_signature_marker_t);
-    } else {
-      m_data_size = file_size;
+  if (marker_size == 0) {
+    // with nothing to hold back, data is read straight into the page
+    // that is sent to the device rather than copied there
+    while (is_append_ready() && bytes_read < input_size && is_success()) {
+      const u32 page_offset = m_bytes_written % APPFS_PAGE_SIZE;
+      const u32 input_left = input_size - bytes_read > m_data_size
+                               ? m_data_size
+                               : u32(input_size - bytes_read);
+      const u32 data_left = m_data_size - m_bytes_written;
+      const u32 size_left = input_left < data_left ? input_left : data_left;
+      const u32 page_size_available = APPFS_PAGE_SIZE - page_offset;
+      const int result
+        = file
+            .read(var::View(
+              m_create_install_attributes.buffer + page_offset,
+              size_left > page_size_available ? page_size_available
+                                              : size_left))
+            .return_value();
+      if (result <= 0) {
+        break;
+      }
+
+      bytes_read += result;
+      commit_page_data(result);
+
+      if (progress_callback) {
+        progress_callback->update(bytes_read, progress_total);
+      }
+    }
+
+    if (is_error()) {
+      return abort_append();
     }
   }
+#if SOS_API_USE_CRYPTO_API
+  else {
+    var::Array<u8, APPFS_PAGE_SIZE + sizeof(auth_signature_marker_t)> buffer;
+    size_t held_size = 0;
+    while (is_append_ready() && is_success()) {
+      const int result
+        = file
+            .read(var::View(buffer).pop_front(held_size).truncate(
+              APPFS_PAGE_SIZE))
+            .return_value();
+      if (result <= 0) {
+        break;
+      }
+
+      bytes_read += result;
+      held_size += result;
+      if (held_size > marker_size) {
+        const size_t send_size = held_size - marker_size;
+        append_view(var::View(buffer).truncate(send_size));
+        memmove(buffer.data(), buffer.data() + send_size, marker_size);
+        held_size = marker_size;
+      }
 
-  const auto progress_size
-    = m_request == I_APPFS_INSTALL ? m_data_size : m_data_size - overhead();
+      if (progress_callback) {
+        progress_callback->update(bytes_read, progress_total);
+      }
+    }
 
-  var::Array<char, APPFS_PAGE_SIZE> buffer;
+    if (is_error()) {
+      return abort_append();
+    }
 
-  var::View buffer_view(buffer);
-  buffer_view.fill(0);
+    const var::View tail = var::View(buffer).truncate(held_size);
+    if (held_size == marker_size) {
+      signature = Auth::get_signature(fs::ViewFile(tail));
+    }
 
-  size_t bytes_written = 0;
-  while (file.read(buffer_view).return_value() > 0
-         && bytes_written < m_data_size) {
-    const auto next = bytes_written + return_value();
-    const auto page_size
-      = next > m_data_size ? m_data_size - bytes_written : return_value();
-    bytes_written += page_size;
-    append_view(var::View(buffer).truncate(page_size));
-    if (progress_callback) {
-      progress_callback->update(bytes_written, progress_size);
+    is_signature_required = Appfs::is_signature_required();
+    // a required signature isn't part of the installed image
+    if (
+      tail.size()
+      && (is_signature_required == false || signature.is_valid() == false)) {
+      append_view(tail);
+    }
+  }
+#endif
+
+  if (is_size_known == false) {
+    // flush the last partial page
+    m_data_size = m_bytes_written;
+    const u32 page_size = m_bytes_written % APPFS_PAGE_SIZE;
+    if (page_size) {
+      m_create_install_attributes.nbyte = page_size;
+      write_page();
     }
   }
 
 #if SOS_API_USE_CRYPTO_API
-  if (is_signature_required && m_request == I_APPFS_INSTALL) {
+  if (is_signature_required) {
     appfs_verify_signature_t verify_signature;
     View(verify_signature.data).copy(signature.data());
     m_file.ioctl(I_APPFS_VERIFY_SIGNATURE, &verify_signature);
@@ -210,7 +316,7 @@ Appfs &Appfs::append(
     progress_callback->update(0, 0);
   }
 
-  return *this;
+  return is_error() ? abort_append() : *this;
 }
 
 void Appfs::append_view(var::View blob) {
@@ -232,24 +338,208 @@ void Appfs::append_view(var::View blob) {
       blob.to_const_u8() + bytes_written,
       page_size);
 
-    m_bytes_written += page_size;
     bytes_written += page_size;
+    commit_page_data(page_size);
+  }
+}
 
+void Appfs::commit_page_data(u32 size) {
+  m_bytes_written += size;
+
+  if (
+    ((m_bytes_written % APPFS_PAGE_SIZE) == 0) // at page boundary
+    || (m_bytes_written == m_data_size)) {     // or to the end
+
+    const u32 page_size = m_bytes_written % APPFS_PAGE_SIZE;
+    if (page_size == 0) {
+      m_create_install_attributes.nbyte = APPFS_PAGE_SIZE;
+    } else {
+      m_create_install_attributes.nbyte = page_size;
+    }
+
+    write_page();
+  }
+}
+
+void Appfs::write_page() {
+  if (
+    m_request == I_APPFS_INSTALL && m_create_install_attributes.loc == 0
+    && m_create_install_attributes.nbyte >= sizeof(appfs_file_t)
+    && !m_name.is_empty()) {
+    auto *f
+      = reinterpret_cast<appfs_file_t *>(m_create_install_attributes.buffer);
+    var::View(f->hdr.name)
+      .fill<u8>(0)
+      .truncate(sizeof(f->hdr.name))
+      .copy(m_name.string_view());
+  }
+
+  m_file.ioctl(m_request, &m_create_install_attributes);
+  m_create_install_attributes.loc += m_create_install_attributes.nbyte;
+}
+
+Appfs::InfoList Appfs::get_inventory(InventoryCache *inventory_cache) const {
+  InfoList result;
+  API_RETURN_VALUE_IF_ERROR(result);
+  if (append_inventory(
+        result,
+        "/app/flash",
+        inventory_cache ? &inventory_cache->m_flash : nullptr)) {
+    inventory_cache->m_hit_count++;
+  }
+  if (append_inventory(
+        result,
+        "/app/ram",
+        inventory_cache ? &inventory_cache->m_ram : nullptr)) {
+    inventory_cache->m_hit_count++;
+  }
+  return result;
+}
+
+bool Appfs::append_inventory(
+  InfoList &info_list,
+  var::StringView directory,
+  InventoryCache::Directory *cache) const {
+
+  API_RETURN_VALUE_IF_ERROR(false);
+
+  var::Vector<var::NameString> name_list;
+  {
+    FILE_BASE::Dir dir(directory FSAPI_LINK_MEMBER_DRIVER_LAST);
+    if (is_error()) {
+      // a device without the directory has nothing installed there
+      if (error().error_number() == ENOENT) {
+        API_RESET_ERROR();
+      }
+      return false;
+    }
+
+    const char *entry;
+    while ((entry = dir.read()) != nullptr) {
+      // skip ., .., .sys and .free without opening them
+      if (entry[0] != '.') {
+        name_list.push_back(var::NameString(entry));
+      }
+    }
+  }
+  API_RETURN_VALUE_IF_ERROR(false);
+
+  const bool is_cached = [&]() {
     if (
-      ((m_bytes_written % APPFS_PAGE_SIZE) == 0) // at page boundary
-      || (m_bytes_written == m_data_size)) {     // or to the end
-
-      page_size = m_bytes_written % APPFS_PAGE_SIZE;
-      if (page_size == 0) {
-        m_create_install_attributes.nbyte = APPFS_PAGE_SIZE;
-      } else {
-        m_create_install_attributes.nbyte = page_size;
+      cache == nullptr || cache->is_valid == false
+      || cache->name_list.count() != name_list.count()) {
+      return false;
+    }
+    for (size_t i = 0; i < name_list.count(); i++) {
+      if (
+        cache->name_list.at(i).string_view()
+        != name_list.at(i).string_view()) {
+        return false;
       }
+    }
+    return true;
+  }();
 
-      m_file.ioctl(m_request, &m_create_install_attributes);
-      m_create_install_attributes.loc += m_create_install_attributes.nbyte;
+  if (is_cached) {
+    for (const auto &info : cache->info_list) {
+      info_list.push_back(info);
     }
+    return true;
   }
+
+  InfoList directory_info_list;
+  directory_info_list.reserve(name_list.count());
+  for (const auto &name : name_list) {
+    const var::PathString path
+      = var::PathString(directory).append("/").append(name.string_view());
+    const Info info = get_info(path);
+    if (is_error()) {
+      // entries that aren't apps or data files are left out
+      const int error_number = error().error_number();
+      if (error_number != ENOEXEC && error_number != EINVAL) {
+        return false;
+      }
+      API_RESET_ERROR();
+      continue;
+    }
+
+    if (info.is_valid()) {
+      directory_info_list.push_back(info);
+    }
+  }
+
+  for (const auto &info : directory_info_list) {
+    info_list.push_back(info);
+  }
+
+  if (cache) {
+    cache->is_valid = true;
+    cache->name_list = std::move(name_list);
+    cache->info_list = std::move(directory_info_list);
+  }
+  return false;
+}
+
+Appfs::InstallStatus Appfs::install(const Install &options) {
+  API_RETURN_VALUE_IF_ERROR(InstallStatus::null);
+  API_ASSERT(options.file() != nullptr);
+  const fs::FileObject &file = *options.file();
+
+  // the device sets these when the app is installed
+  constexpr u32 device_o_flags
+    = APPFS_FLAG_IS_AUTHENTICATED | APPFS_FLAG_IS_ORPHAN;
+
+  var::NameString name(options.name());
+  bool is_unchanged = false;
+  if (options.is_skip_unchanged() || name.is_empty()) {
+    const auto attributes = [&]() {
+      fs::File::LocationScope location_scope(file);
+      return FileAttributes(file);
+    }();
+    API_RETURN_VALUE_IF_ERROR(InstallStatus::null);
+
+    if (name.is_empty()) {
+      name = var::NameString(attributes.name());
+    }
+
+    is_unchanged = [&]() {
+      if (options.is_skip_unchanged() == false) {
+        return false;
+      }
+
+      const var::PathString path
+        = var::PathString(attributes.is_flash() ? "/app/flash/" : "/app/ram/")
+            .append(name.string_view());
+
+      // an app that isn't installed yet is not an error
+      api::ErrorScope error_scope;
+      const Info info = get_info(path);
+      return info.is_valid() && info.signature() == attributes.signature()
+             && info.version() == attributes.version()
+             && info.id() == attributes.id()
+             && (info.o_flags() & ~device_o_flags)
+                  == (static_cast<u32>(attributes.flags()) & ~device_o_flags);
+    }();
+  }
+
+  if (is_unchanged == false) {
+    Appfs(
+      Construct().set_executable(true).set_name(name.string_view())
+        FSAPI_LINK_MEMBER_DRIVER_LAST)
+      .append(file, options.progress_callback());
+    if (options.inventory_cache()) {
+      options.inventory_cache()->invalidate();
+    }
+    API_RETURN_VALUE_IF_ERROR(InstallStatus::null);
+  }
+
+  if (options.printer()) {
+    options.printer()->key(
+      name.string_view(),
+      is_unchanged ? "skipped" : "installed");
+  }
+
+  return is_unchanged ? InstallStatus::skipped : InstallStatus::installed;
 }
 
 bool Appfs::is_flash_available() const {
@@ -268,6 +558,17 @@ bool Appfs::is_ram_available() const {
   return first_entry != nullptr;
 }
 
+Appfs &Appfs::abort_append() {
+  // pages that were already sent stay on the device, so the install
+  // is incomplete and this object can't be appended to again
+  m_is_aborted = true;
+  m_data_size = 0;
+  m_bytes_written = 0;
+  m_create_install_attributes.loc = 0;
+  m_create_install_attributes.nbyte = 0;
+  return *this;
+}
+
 bool Appfs::is_signature_required() const {
   API_RETURN_VALUE_IF_ERROR(false);
   // use an error scope because not all devices will support
@@ -0,0 +1,193 @@
+// Copyright 2016-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#if defined __link && SOS_API_USE_CRYPTO_API
+
+#include <sys/stat.h>
+
+#include <cstring>
+
+#include <fs/File.hpp>
+#include <fs/FileSystem.hpp>
+#include <fs/ViewFile.hpp>
+
+#include "sos/ImageStore.hpp"
+
+using namespace sos;
+
+namespace {
+u64 get_modification_time(const struct stat &st) {
+  // seconds alone would miss a rebuild within the same second
+#if defined __win32
+  return static_cast<u64>(st.st_mtime) * 1000000000ULL;
+#elif defined __APPLE__
+  return static_cast<u64>(st.st_mtimespec.tv_sec) * 1000000000ULL
+         + st.st_mtimespec.tv_nsec;
+#else
+  return static_cast<u64>(st.st_mtim.tv_sec) * 1000000000ULL
+         + st.st_mtim.tv_nsec;
+#endif
+}
+} // namespace
+
+ImageStore::ImageStore(var::StringView path) : m_path(path) {
+  // a missing or stale store is not an error -- it is just empty
+  api::ErrorScope error_scope;
+
+  if (fs::FileSystem().exists(m_path) == false) {
+    return;
+  }
+
+  fs::File file(m_path);
+  u32 version = 0;
+  u32 count = 0;
+  file.read(var::View(version)).read(var::View(count));
+  if (is_error() || version != file_version) {
+    return;
+  }
+
+  m_record_list.reserve(count);
+  for (u32 i = 0; i < count; i++) {
+    Record record = {};
+    if (
+      file.read(var::View(record)).return_value()
+      != static_cast<int>(sizeof(Record))) {
+      break;
+    }
+    record.path[path_capacity - 1] = 0;
+    m_record_list.push_back(record);
+  }
+}
+
+ImageStore::~ImageStore() {
+  api::ErrorGuard error_guard;
+  if (m_is_dirty) {
+    save();
+  }
+}
+
+ImageStore::Entry ImageStore::get(var::StringView image_path) {
+  API_RETURN_VALUE_IF_ERROR(Entry());
+  const var::PathString path(image_path);
+  if (path.length() >= path_capacity) {
+    API_RETURN_VALUE_ASSIGN_ERROR(Entry(), "image path is too long", EINVAL);
+  }
+
+  struct stat st = {};
+  if (::stat(path.cstring(), &st) < 0) {
+    API_SYSTEM_CALL(path.cstring(), -1);
+    return Entry();
+  }
+
+  for (const auto &record : m_record_list) {
+    if (
+      path == var::StringView(record.path)
+      && record.size == static_cast<u32>(st.st_size)
+      && record.modification_time == get_modification_time(st)) {
+      return get_entry(record);
+    }
+  }
+
+  Record record = get_record(path);
+  API_RETURN_VALUE_IF_ERROR(Entry());
+  record.modification_time = get_modification_time(st);
+
+  // the same path with different contents replaces the old record
+  bool is_replaced = false;
+  for (auto &existing : m_record_list) {
+    if (path == var::StringView(existing.path)) {
+      existing = record;
+      is_replaced = true;
+      break;
+    }
+  }
+
+  if (is_replaced == false) {
+    m_record_list.push_back(record);
+  }
+
+  m_is_dirty = true;
+  return get_entry(record);
+}
+
+ImageStore::Entry ImageStore::find(const crypto::Sha256::Hash &hash) const {
+  for (const auto &record : m_record_list) {
+    if (var::View(record.hash) == var::View(hash)) {
+      return get_entry(record);
+    }
+  }
+  return Entry();
+}
+
+ImageStore &ImageStore::save() {
+  API_RETURN_VALUE_IF_ERROR(*this);
+  const u32 version = file_version;
+  const u32 count = m_record_list.count();
+
+  fs::File file(fs::File::IsOverwrite::yes, m_path);
+  file.write(var::View(version)).write(var::View(count));
+
+  for (const auto &record : m_record_list) {
+    file.write(var::View(record));
+  }
+
+  if (is_success()) {
+    m_is_dirty = false;
+  }
+  return *this;
+}
+
+ImageStore::Entry ImageStore::get_entry(const Record &record) {
+  crypto::Sha256::Hash hash;
+  var::View(hash).copy(var::View(record.hash));
+
+  auto signature_info = Auth::SignatureInfo().set_size(record.size);
+  if (record.signed_size) {
+    crypto::Sha256::Hash signed_hash;
+    var::View(signed_hash).copy(var::View(record.signed_hash));
+    signature_info.set_size(record.signed_size)
+      .set_hash(signed_hash)
+      .set_signature(crypto::Dsa::Signature(var::View(record.signature)));
+  }
+
+  return Entry()
+    .set_hash(hash)
+    .set_size(record.size)
+    .set_hardware_id(record.hardware_id)
+    .set_signature_info(signature_info);
+}
+
+ImageStore::Record ImageStore::get_record(var::StringView image_path) {
+  Record result = {};
+  const Link::MappedImage image(image_path);
+  const var::View view = image.view();
+  if (image.is_error() || view.size() == 0) {
+    API_RETURN_VALUE_ASSIGN_ERROR(result, "image is empty", EINVAL);
+  }
+
+  var::View(result.path).copy(image_path);
+  result.size = view.size();
+
+  const auto hash = crypto::Sha256::get_hash(fs::ViewFile(view));
+  var::View(result.hash).copy(var::View(hash));
+
+  if (view.size() >= BOOTLOADER_HARDWARE_ID_OFFSET + sizeof(u32)) {
+    memcpy(
+      &result.hardware_id,
+      view.to_const_u8() + BOOTLOADER_HARDWARE_ID_OFFSET,
+      sizeof(u32));
+  }
+
+  // hashes the image a second time but only for signed images
+  const auto signature_info = Auth::get_signature_info(fs::ViewFile(view));
+  if (signature_info.signature().is_valid()) {
+    result.signed_size = signature_info.size();
+    var::View(result.signed_hash).copy(var::View(signature_info.hash()));
+    var::View(result.signature).copy(signature_info.signature().data());
+  }
+
+  return result;
+}
+
+#else
+int sos_api_image_store_unused;
+#endif
@@ -5,6 +5,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <random>
 #include <sos/dev/sys.h>
 #include <sos/fs/sysfs.h>
 #include <sstream>
@@ -15,10 +16,13 @@
 #include <fs/File.hpp>
 #include <fs/Path.hpp>
 #include <fs/ViewFile.hpp>
+#include <thread/Mutex.hpp>
+#include <thread/Thread.hpp>
 #include <var.hpp>
 
 #include "sos/Appfs.hpp"
 #include "sos/Auth.hpp"
+#include "sos/ImageStore.hpp"
 #include "sos/Link.hpp"
 #include "sos/Sys.hpp"
 
@@ -39,6 +43,58 @@ Printer &operator<<(Printer &printer, const sos::Link::InfoList &a) {
   }
   return printer;
 }
+
+Printer &
+operator<<(Printer &printer, const sos::Link::ReconnectReport &a) {
+  return printer
+    .key(
+      "lastPathMicroseconds",
+      var::NumberString(a.last_path_duration().microseconds()))
+    .key("scanMicroseconds", var::NumberString(a.scan_duration().microseconds()))
+    .key(
+      "probeMicroseconds",
+      var::NumberString(a.probe_duration().microseconds()))
+    .key("waitMicroseconds", var::NumberString(a.wait_duration().microseconds()))
+    .key("scanCount", var::NumberString(a.scan_count()))
+    .key("probeCount", var::NumberString(a.probe_count()));
+}
+
+Printer &operator<<(Printer &printer, const sos::Link::UpdateReport &a) {
+  return printer
+    .key(
+      "eraseMicroseconds",
+      var::NumberString(a.erase_duration().microseconds()))
+    .key(
+      "writeMicroseconds",
+      var::NumberString(a.write_duration().microseconds()))
+    .key(
+      "verifyMicroseconds",
+      var::NumberString(a.verify_duration().microseconds()))
+    .key("chunkSize", var::NumberString(a.chunk_size()))
+    .key("writeCount", var::NumberString(a.write_count()))
+    .key("skippedSize", var::NumberString(a.skipped_size()))
+    .key("bytesPerSecond", var::NumberString(a.bytes_per_second()))
+    .key("resumeOffset", var::NumberString(a.resume_offset()));
+}
+
+Printer &operator<<(Printer &printer, const sos::Link::CompareReport &a) {
+  printer.key("address", var::NumberString(a.address(), "0x%08lx"))
+    .key("pageSize", var::NumberString(a.page_size()))
+    .key_bool("strict", a.is_strict())
+    .key("sampleInterval", var::NumberString(a.sample_interval()))
+    .key("pageCount", var::NumberString(a.page_count()))
+    .key("comparedPageCount", var::NumberString(a.compared_page_count()))
+    .key("mismatchCount", var::NumberString(a.mismatch_list().count()))
+    .key_bool("match", a.is_match());
+
+  int i = 0;
+  for (const auto address : a.mismatch_list()) {
+    printer.key(
+      var::KeyString().format("mismatch@%d", i++),
+      var::NumberString(address, "0x%08lx"));
+  }
+  return printer;
+}
 } // namespace printer
 
 using namespace fs;
@@ -102,6 +158,163 @@ var::Vector<Link::Info> Link::get_info_list() {
   return result;
 }
 
+namespace {
+struct InfoListWorkerContext {
+  thread::Mutex mutex;
+  link_transport_mdriver_t *driver = nullptr;
+  const fs::PathList *path_list = nullptr;
+  u32 next_index = 0;
+  // one entry per path, invalid paths are left with an empty path
+  var::Vector<Link::Info> info_list;
+};
+
+u32 get_install_chunk_size(const Link::UpdateOs &options) {
+  const u32 minimum = Link::UpdateOs::minimum_chunk_size;
+  const u32 maximum = Link::UpdateOs::maximum_chunk_size;
+  const u32 result = options.chunk_size() - options.chunk_size() % minimum;
+  return result < minimum ? minimum : (result > maximum ? maximum : result);
+}
+
+// seeded once per thread so that processes (and workers) don't
+// repeat the same sequence
+u32 get_random_value() {
+  thread_local std::mt19937 generator(
+    std::random_device()()
+    ^ static_cast<u32>(chrono::DateTime::get_system_time().ctime()));
+  return generator();
+}
+
+bool is_erased(var::View view) {
+  const u8 *data = view.to_const_u8();
+  for (size_t i = 0; i < view.size(); i++) {
+    if (data[i] != 0xff) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// used for the dump_flash() manifest
+#if SOS_API_USE_CRYPTO_API
+constexpr const char *page_hash_name = "sha256";
+
+var::GeneralString get_page_hash(var::View page) {
+  return var::View(crypto::Sha256::get_hash(fs::ViewFile(page)))
+    .to_string<var::GeneralString>();
+}
+#else
+constexpr const char *page_hash_name = "crc32";
+
+var::GeneralString get_page_hash(var::View page) {
+  u32 result = 0xffffffff;
+  for (size_t i = 0; i < page.size(); i++) {
+    result ^= page.to_const_u8()[i];
+    for (int bit = 0; bit < 8; bit++) {
+      result = (result >> 1) ^ (0xedb88320 & (0 - (result & 1)));
+    }
+  }
+  return var::GeneralString(var::NumberString(~result, "%08lx").string_view());
+}
+#endif
+
+const api::ProgressCallback *
+get_progress_callback(const Link::UpdateOs &options) {
+  return options.progress_callback() ? options.progress_callback()
+                                     : options.printer()->progress_callback();
+}
+} // namespace
+
+void *Link::get_info_list_worker(void *args) {
+  auto *context = reinterpret_cast<InfoListWorkerContext *>(args);
+
+  // each worker has its own driver instance so probes don't share a phy
+  Link link;
+  link.set_driver(context->driver).disregard_connection();
+
+  while (true) {
+    const u32 index = [&]() {
+      thread::Mutex::Scope mutex_scope(context->mutex);
+      return context->next_index++;
+    }();
+
+    if (index >= context->path_list->count()) {
+      break;
+    }
+
+    const auto &path = context->path_list->at(index);
+    link.connect(path);
+    if (link.is_success()) {
+      const Info info(path, link.info().sys_info());
+      link.disconnect();
+      thread::Mutex::Scope mutex_scope(context->mutex);
+      context->info_list.at(index) = info;
+    } else {
+      API_RESET_ERROR();
+    }
+  }
+
+  return nullptr;
+}
+
+var::Vector<Link::Info> Link::get_info_list(const GetInfoList &options) {
+  if (options.thread_count() <= 1) {
+    return get_info_list();
+  }
+
+  var::Vector<Info> result;
+  API_RETURN_VALUE_IF_ERROR(result);
+
+  const auto path_list = get_path_list();
+
+  // disconnect if already connected
+  disconnect();
+
+  InfoListWorkerContext context;
+  context.driver = driver();
+  context.path_list = &path_list;
+  context.info_list.resize(path_list.count());
+
+  const u32 thread_count = path_list.count() < options.thread_count()
+                             ? path_list.count()
+                             : options.thread_count();
+
+  var::Vector<thread::Thread> thread_list;
+  thread_list.reserve(thread_count);
+  for (u32 i = 0; i < thread_count; i++) {
+    thread::Thread thread(
+      thread::Thread::Attributes().set_detach_state(
+        thread::Thread::DetachState::joinable),
+      thread::Thread::Construct().set_argument(&context).set_function(
+        get_info_list_worker));
+    if (is_error()) {
+      API_RESET_ERROR();
+      break;
+    }
+    thread_list.push_back(std::move(thread));
+  }
+
+  if (thread_list.count() < thread_count) {
+    // paths that a missing worker would have probed are probed here
+    get_info_list_worker(&context);
+  }
+
+  for (auto &thread : thread_list) {
+    thread.join();
+  }
+
+  // keep the same ordering as the serial scan
+  for (const auto &info : context.info_list) {
+    if (!info.path().is_empty()) {
+      result.push_back(info);
+      if (m_info_cache) {
+        m_info_cache->update(info);
+      }
+    }
+  }
+
+  return result;
+}
+
 Link::Connection Link::ping_connection(const var::StringView path) {
   API_RETURN_VALUE_IF_ERROR(Connection::null);
   if (driver()->phy_driver.handle == LINK_PHY_OPEN_ERROR) {
@@ -178,43 +391,199 @@ Link &Link::connect(var::StringView path, IsLegacy is_legacy) {
   }
 
   m_link_info = Info(path, sys_info);
+  if (m_info_cache) {
+    m_info_cache->update(m_link_info);
+  }
   return *this;
 }
 
+Link &Link::connect(
+  const SerialNumber &serial_number,
+  IsLegacy is_legacy) {
+  API_RETURN_VALUE_IF_ERROR(*this);
+
+  if (is_connected()) {
+    if (info().serial_number() == serial_number) {
+      return *this;
+    }
+    disconnect();
+  }
+
+  if (m_info_cache) {
+    const auto entry = m_info_cache->find(serial_number);
+    if (
+      entry.is_valid()
+      && connect_serial_number(entry.info().path(), serial_number, is_legacy)) {
+      return *this;
+    }
+  }
+
+  // cache miss -- scan all the paths
+  const auto path_list = get_path_list();
+  for (const auto &path : path_list) {
+    if (connect_serial_number(path, serial_number, is_legacy)) {
+      return *this;
+    }
+  }
+
+  API_RETURN_VALUE_ASSIGN_ERROR(
+    *this,
+    "no device with serial number " | serial_number.to_string(),
+    ENODEV);
+}
+
+bool Link::connect_serial_number(
+  var::StringView path,
+  const SerialNumber &serial_number,
+  IsLegacy is_legacy) {
+  connect(path, is_legacy);
+
+  if (is_error()) {
+    API_RESET_ERROR();
+    return false;
+  }
+
+  if (info().serial_number() == serial_number) {
+    return true;
+  }
+
+  disconnect();
+  return false;
+}
+
 Link &Link::reconnect(int retries, chrono::MicroTime delay) {
+  // keep the overall budget and the number of scans of the
+  // fixed-delay interface
+  return reconnect(
+    Reconnect()
+      .set_timeout(chrono::MicroTime(delay.microseconds() * retries))
+      .set_maximum_delay(delay)
+      .set_minimum_scan_count(retries > 0 ? retries : 0));
+}
+
+Link &Link::reconnect(const Reconnect &options) {
   API_RETURN_VALUE_IF_ERROR(*this);
-  Info last_info(info());
-  for (int i = 0; i < retries; i++) {
-    connect(last_info.path());
+  m_reconnect_report = ReconnectReport();
 
-    if (is_success()) {
-      if (last_info.serial_number() == info().serial_number()) {
-        return *this;
+  const Info last_info(info());
+  const SerialNumber serial_number = last_info.serial_number();
+
+  auto is_in_list = [](const fs::PathList &list, var::StringView path) {
+    for (const auto &item : list) {
+      if (item == path) {
+        return true;
       }
-      disconnect();
-    } else {
-      API_RESET_ERROR();
     }
+    return false;
+  };
+
+  chrono::ClockTimer total_timer;
+  chrono::ClockTimer phase_timer;
+  total_timer.start();
+  phase_timer.start();
 
-    const auto port_list = get_path_list();
-    for (u32 j = 0; j < port_list.count(); j++) {
-      connect(port_list.at(j));
+  bool is_found = connect_serial_number(last_info.path(), serial_number);
 
-      if (is_success()) {
-        if (last_info.serial_number() == info().serial_number()) {
-          return *this;
+  if (!is_found && m_info_cache) {
+    const auto entry = m_info_cache->find(serial_number);
+    is_found = entry.is_valid() && (entry.info().path() != last_info.path())
+               && connect_serial_number(entry.info().path(), serial_number);
+  }
+
+  m_reconnect_report.set_last_path_duration(phase_timer.micro_time());
+
+  u64 scan_microseconds = 0;
+  u64 probe_microseconds = 0;
+  u64 wait_microseconds = 0;
+  u32 probe_count = 0;
+  u32 scan_count = 0;
+  u64 delay_microseconds = options.initial_delay().microseconds();
+
+  const u32 jitter_percent
+    = options.jitter_percent() > 100 ? 100 : options.jitter_percent();
+
+  // paths that answered with a different serial number are skipped
+  // until they disappear from the list or the list is reset (some hosts
+  // reuse a path for the re-enumerated device)
+  constexpr u32 other_device_reset_interval = 4;
+  fs::PathList other_device_list;
+
+  while (!is_found
+         && (scan_count < options.minimum_scan_count()
+             || total_timer.micro_time().microseconds()
+                  < options.timeout().microseconds())) {
+
+    phase_timer.restart();
+    const auto path_list = get_path_list();
+    scan_microseconds += phase_timer.micro_time().microseconds();
+    scan_count++;
+
+    if (scan_count % other_device_reset_interval == 0) {
+      other_device_list = fs::PathList();
+    } else {
+      fs::PathList still_present_list;
+      for (const auto &path : other_device_list) {
+        if (is_in_list(path_list, path)) {
+          still_present_list.push_back(path);
         }
-        disconnect();
-      } else {
+      }
+      other_device_list = still_present_list;
+    }
+
+    phase_timer.restart();
+    for (const auto &path : path_list) {
+      if (is_in_list(other_device_list, path)) {
+        continue;
+      }
+
+      probe_count++;
+      connect(path);
+      if (is_error()) {
+        // not ready yet -- try again on the next scan
         API_RESET_ERROR();
+        continue;
       }
+
+      if (info().serial_number() == serial_number) {
+        is_found = true;
+        break;
+      }
+
+      disconnect();
+      other_device_list.push_back(path);
+    }
+    probe_microseconds += phase_timer.micro_time().microseconds();
+
+    if (is_found) {
+      break;
     }
 
-    chrono::wait(delay);
+    const u64 jitter_range = delay_microseconds * jitter_percent / 100;
+    const u64 wait_time
+      = jitter_range ? delay_microseconds - jitter_range
+                         + get_random_value() % (2 * jitter_range + 1)
+                     : delay_microseconds;
+
+    phase_timer.restart();
+    chrono::wait(chrono::MicroTime(wait_time));
+    wait_microseconds += phase_timer.micro_time().microseconds();
+
+    delay_microseconds *= 2;
+    if (delay_microseconds > options.maximum_delay().microseconds()) {
+      delay_microseconds = options.maximum_delay().microseconds();
+    }
   }
 
-  // restore the last known information on failure
-  m_link_info = last_info;
+  m_reconnect_report.set_scan_duration(chrono::MicroTime(scan_microseconds))
+    .set_probe_duration(chrono::MicroTime(probe_microseconds))
+    .set_wait_duration(chrono::MicroTime(wait_microseconds))
+    .set_scan_count(scan_count)
+    .set_probe_count(probe_count);
+
+  if (!is_found) {
+    // restore the last known information on failure
+    m_link_info = last_info;
+  }
 
   return *this;
 }
@@ -529,7 +898,7 @@ Link &Link::get_bootloader_attr(bootloader_attr_t &attr) {
 }
 
 u32 Link::validate_os_image_id_with_connected_bootloader(
-  const FileObject *source_image,
+  var::View image,
   UseBootloaderId use_bootloader_info) {
   API_RETURN_VALUE_IF_ERROR(0);
   u32 image_id;
@@ -546,14 +915,16 @@ u32 Link::validate_os_image_id_with_connected_bootloader(
   m_progress_max = 0;
   m_progress = 0;
 
-  if (source_image->seek(BOOTLOADER_HARDWARE_ID_OFFSET)
-        .read(var::View(image_id))
-        .seek(0)
-        .is_error()) {
-    return 0;
+  if (image.size() < BOOTLOADER_HARDWARE_ID_OFFSET + sizeof(image_id)) {
+    API_RETURN_VALUE_ASSIGN_ERROR(0, "image is too small", EINVAL);
   }
 
-  m_progress_max = static_cast<int>(source_image->size());
+  memcpy(
+    &image_id,
+    image.to_const_u8() + BOOTLOADER_HARDWARE_ID_OFFSET,
+    sizeof(image_id));
+
+  m_progress_max = static_cast<int>(image.size());
 
   const u32 hardware_id = use_bootloader_info == UseBootloaderId::yes
                             ? m_bootloader_attributes.hardware_id
@@ -584,10 +955,13 @@ Link &Link::erase_os(const UpdateOs &options) {
   }
 
   const api::ProgressCallback *progress_callback
-    = options.printer()->progress_callback();
+    = get_progress_callback(options);
 
   options.printer()->set_progress_key("erasing");
 
+  chrono::ClockTimer erase_timer;
+  erase_timer.start();
+
   // first erase the flash
   API_SYSTEM_CALL("", link_eraseflash(driver()));
   API_RETURN_VALUE_IF_ERROR(*this);
@@ -598,16 +972,41 @@ Link &Link::erase_os(const UpdateOs &options) {
       api::ProgressCallback::indeterminate_progress_total());
   }
 
+  // the bootloader doesn't answer until the erase is complete. Polling
+  // starts just before the last observed erase time then backs off.
+  const chrono::MicroTime predicted_duration = [&]() {
+    if (m_info_cache) {
+      const auto entry = m_info_cache->find(m_link_info.serial_number());
+      if (entry.is_valid()) {
+        return entry.erase_duration();
+      }
+    }
+    return m_erase_duration;
+  }();
+
+  const u64 timeout_microseconds
+    = predicted_duration.microseconds()
+      + u64(options.bootloader_retry_count()) * 500000;
+
+  if (predicted_duration.microseconds() > 0) {
+    chrono::wait(
+      chrono::MicroTime(predicted_duration.microseconds() * 9 / 10));
+  }
+
   bootloader_attr_t attr = {};
   u32 retry = 0;
   bool is_waiting = true;
+  u64 poll_microseconds = 50000;
   do {
     API_RESET_ERROR();
-    chrono::wait(500_milliseconds);
     get_bootloader_attr(attr);
     if (is_error()) {
       API_RESET_ERROR();
       driver()->phy_driver.flush(driver()->phy_driver.handle);
+      retry++;
+      chrono::wait(chrono::MicroTime(poll_microseconds));
+      poll_microseconds
+        = poll_microseconds * 2 > 500000 ? 500000 : poll_microseconds * 2;
     } else {
       is_waiting = false;
     }
@@ -617,13 +1016,27 @@ Link &Link::erase_os(const UpdateOs &options) {
         retry,
         api::ProgressCallback::indeterminate_progress_total());
     }
-  } while (is_waiting && (retry++ < options.bootloader_retry_count()));
+  } while (is_waiting
+           && erase_timer.micro_time().microseconds() < timeout_microseconds);
 
-  const bool is_error_state = is_error();
+  const bool is_error_state = is_waiting;
+  const chrono::MicroTime erase_duration = erase_timer.micro_time();
 
-  chrono::wait(250_milliseconds);
-  // flush just incase the protocol gets filled with get attr requests
-  driver()->phy_driver.flush(driver()->phy_driver.handle);
+  if (retry > 0) {
+    chrono::wait(250_milliseconds);
+    // flush just incase the protocol gets filled with get attr requests
+    driver()->phy_driver.flush(driver()->phy_driver.handle);
+  }
+
+  m_update_report.set_erase_duration(erase_duration);
+  if (is_error_state == false) {
+    m_erase_duration = erase_duration;
+    if (m_info_cache) {
+      m_info_cache->update_erase_duration(
+        m_link_info.serial_number(),
+        erase_duration);
+    }
+  }
 
   if (progress_callback) {
     progress_callback->update(0, 0);
@@ -663,7 +1076,12 @@ var::Array<u8, 64> Link::get_public_key() {
   return result;
 }
 
-Link &Link::install_os(u32 image_id, const UpdateOs &options) {
+Link &Link::install_os(
+  u32 image_id,
+  var::View image,
+  const UpdateOs &options,
+  u32 resume_offset,
+  InstallJournal *journal) {
   API_RETURN_VALUE_IF_ERROR(*this);
 
   if (is_connected() == false) {
@@ -676,21 +1094,16 @@ Link &Link::install_os(u32 image_id, const UpdateOs &options) {
 
   // must be connected to the bootloader with an erased OS
   int err = -1;
-  const int buffer_size = 1024;
+  const u32 chunk_size = get_install_chunk_size(options);
+  // the chunk size can grow after the first chunk
+  u32 write_chunk_size = chunk_size;
 
   const api::ProgressCallback *progress_callback
-    = options.printer()->progress_callback();
+    = get_progress_callback(options);
 
   var::Array<u8, 256> start_address_buffer;
-  // var::Data start_address_buffer(256);
-  var::Data buffer(buffer_size);
-  var::Data compare_buffer(buffer_size);
-
-  if (options.image()->seek(0).is_error()) {
-    API_RETURN_VALUE_ASSIGN_ERROR(*this, "", EINVAL);
-  }
-
-  fs::DataFile image_file = fs::DataFile().write(*options.image()).move();
+  var::Data buffer(chunk_size);
+  var::Data compare_buffer(chunk_size);
 
   u32 start_address = m_bootloader_attributes.startaddr;
   u32 loc = start_address;
@@ -707,7 +1120,7 @@ Link &Link::install_os(u32 image_id, const UpdateOs &options) {
   get_bootloader_attr(attr);
   const int is_signature_required = link_is_signature_required(driver(), &attr);
 
-  fs::ViewFile image = fs::ViewFile(image_file.data()).move();
+  var::View image_view(image);
 
   auth_signature_t signature = {};
   auth_signature_marker_t signature_marker;
@@ -715,34 +1128,88 @@ Link &Link::install_os(u32 image_id, const UpdateOs &options) {
     // the signature is the last 64 bytes of the OS image
     // the signature is NOT written to the device
     const auto signature_location
-      = image.size() - sizeof(auth_signature_marker_t);
-    image.seek(signature_location).read(var::View(signature_marker)).seek(0);
+      = image_view.size() - sizeof(auth_signature_marker_t);
+    var::View(signature_marker)
+      .copy(var::View(image_view).pop_front(signature_location));
 
     memcpy(signature.data, signature_marker.signature.data, 64);
 
-    image
-      = fs::ViewFile(var::View(image_file.data()).truncate(signature_location))
-          .move();
+    image_view.truncate(signature_location);
   }
 
   API_RETURN_VALUE_IF_ERROR(*this);
 
-  while (image.read(buffer).return_value() > 0) {
-    const int bytes_read = image.return_value();
+  // chunks are sent straight from the image in memory so the next
+  // chunk is ready as soon as the previous write returns. Only the
+  // first chunk is copied so the start page can be held back.
+  auto get_chunk = [&](u32 offset) -> var::View {
+    const u32 size_left = image_view.size() - offset;
+    const u32 size
+      = size_left > write_chunk_size ? write_chunk_size : size_left;
+    var::View result = var::View(image_view).pop_front(offset).truncate(size);
 
     // Version 0x400 and beyond will cache the first page
     // so the sending side does not need to
-    if ((attr.version < 0x400) && (loc == start_address)) {
+    if ((attr.version < 0x400) && (offset == 0)) {
       // we want to write the first 256 bytes last because the bootloader checks
       // this for a valid image
+      var::View(buffer).copy(result);
       var::View buffer_view
         = var::View(buffer).truncate(start_address_buffer.count());
       var::View(start_address_buffer).copy(buffer_view);
       buffer_view.fill<u8>(0xff);
+      result = var::View(buffer).truncate(size);
     }
+    return result;
+  };
+
+  // with an adaptive chunk size, throughput is measured over a window of
+  // writes. The chunk size doubles while throughput improves then settles
+  // on the best size that was measured.
+  const u32 adaptive_window_count = 4;
+  bool is_adapting = options.is_adaptive_chunk_size();
+  u32 best_chunk_size = write_chunk_size;
+  u64 best_bytes_per_second = 0;
+  u32 window_count = 0;
+  u64 window_size = 0;
+  u64 window_microseconds = 0;
+
+  if (resume_offset > 0) {
+    // the start page is still needed when resuming
+    get_chunk(0);
+    loc += resume_offset;
+    m_progress += resume_offset;
+    err = 0;
+  }
+
+  // the journal lags the device by at most this much
+  const u32 journal_interval = 16384;
+  u32 journal_size = resume_offset;
+
+  chrono::ClockTimer write_timer;
+  chrono::ClockTimer chunk_timer;
+  write_timer.start();
 
+  while (loc - start_address < image_view.size()) {
+    const var::View chunk = get_chunk(loc - start_address);
+    const int bytes_read = chunk.size();
+
+    // erase_os() leaves the flash erased so chunks that are all 0xff
+    // don't need to be sent. The first chunk is always sent because
+    // the bootloader handles the start page specially.
+    if (
+      options.is_sparse() && loc != start_address && is_erased(chunk)) {
+      loc += bytes_read;
+      m_progress += bytes_read;
+      m_update_report.set_skipped_size(
+        m_update_report.skipped_size() + bytes_read);
+      err = 0;
+      continue;
+    }
+
+    chunk_timer.restart();
     if (
-      (err = link_writeflash(driver(), loc, buffer.data(), bytes_read))
+      (err = link_writeflash(driver(), loc, chunk.to_const_void(), bytes_read))
       != bytes_read) {
 
       if (err < 0) {
@@ -751,16 +1218,63 @@ Link &Link::install_os(u32 image_id, const UpdateOs &options) {
       break;
     }
 
+    m_update_report.set_write_count(m_update_report.write_count() + 1);
+    window_size += bytes_read;
+    window_microseconds += chunk_timer.micro_time().microseconds();
+    if (is_adapting && ++window_count == adaptive_window_count) {
+      const u64 bytes_per_second
+        = window_microseconds ? window_size * 1000000 / window_microseconds : 0;
+
+      options.printer()->key(
+        var::KeyString().format("bytesPerSecond@%d", int(write_chunk_size)),
+        var::NumberString(u32(bytes_per_second)));
+
+      if (bytes_per_second > best_bytes_per_second) {
+        best_bytes_per_second = bytes_per_second;
+        best_chunk_size = write_chunk_size;
+        if (write_chunk_size * 2 <= UpdateOs::maximum_chunk_size) {
+          write_chunk_size *= 2;
+        } else {
+          is_adapting = false;
+        }
+      } else {
+        write_chunk_size = best_chunk_size;
+        is_adapting = false;
+      }
+
+      window_count = 0;
+      window_size = 0;
+      window_microseconds = 0;
+    }
+
     loc += bytes_read;
     m_progress += bytes_read;
+
+    if (journal && loc - start_address - journal_size >= journal_interval) {
+      journal_size = loc - start_address;
+      journal->set_size(journal_size);
+    }
+
     if (
       progress_callback
       && (progress_callback->update(m_progress, m_progress_max) == api::ProgressCallback::IsAbort::yes)) {
+      // the journal is kept so the install can be resumed from here
+      if (journal) {
+        journal->set_size(loc - start_address);
+      }
       break;
     }
     err = 0;
   }
 
+  const u64 write_microseconds = write_timer.micro_time().microseconds();
+  m_update_report.set_write_duration(write_timer.micro_time())
+    .set_chunk_size(write_chunk_size)
+    .set_bytes_per_second(
+      write_microseconds
+        ? u32(u64(loc - start_address) * 1000000 / write_microseconds)
+        : 0);
+
   if (err == 0) {
 
     // this is called even if the signature
@@ -774,14 +1288,44 @@ Link &Link::install_os(u32 image_id, const UpdateOs &options) {
     // do not allow reading back code
     if (options.is_verify() && !is_signature_required) {
 
-      options.image()->seek(0);
+      chrono::ClockTimer verify_timer;
+      verify_timer.start();
       loc = start_address;
       m_progress = 0;
 
       options.printer()->progress_key() = StringView("verifying");
 
-      while ((options.image()->read(buffer).return_value()) > 0) {
-        const int bytes_read = options.image()->return_value();
+      // the first and last chunks are always read back. The others are
+      // sampled starting at a random chunk so that repeated updates
+      // don't always check the same addresses.
+      const u32 verify_interval
+        = options.verify_interval() ? options.verify_interval() : 1;
+      const u32 verify_phase = get_random_value() % verify_interval;
+      const u32 chunk_count = (image_view.size() + chunk_size - 1) / chunk_size;
+      u32 verified_size = 0;
+
+      while (loc - start_address < image_view.size()) {
+        const u32 size_left = image_view.size() - (loc - start_address);
+        const int bytes_read = size_left > chunk_size ? chunk_size : size_left;
+        var::View image_chunk = var::View(image_view)
+                                  .pop_front(loc - start_address)
+                                  .truncate(bytes_read);
+
+        const u32 chunk_index = (loc - start_address) / chunk_size;
+        const bool is_sampled = chunk_index == 0
+                                || chunk_index == chunk_count - 1
+                                || chunk_index % verify_interval == verify_phase;
+
+        if (is_sampled == false) {
+          loc += bytes_read;
+          m_progress += bytes_read;
+          if (
+            progress_callback
+            && (progress_callback->update(m_progress, m_progress_max) == api::ProgressCallback::IsAbort::yes)) {
+            break;
+          }
+          continue;
+        }
 
         if (
           (err
@@ -802,18 +1346,19 @@ Link &Link::install_os(u32 image_id, const UpdateOs &options) {
         } else {
 
           if (loc == start_address) {
+            var::View(buffer).copy(image_chunk);
             var::View(buffer)
               .truncate(start_address_buffer.count())
               .fill<u8>(0xff);
+            image_chunk = var::View(buffer).truncate(bytes_read);
           }
 
-          compare_buffer.resize(bytes_read);
-          buffer.resize(bytes_read);
-
-          if (var::View(compare_buffer) != var::View(buffer)) {
+          if (
+            var::View(compare_buffer).truncate(bytes_read) != image_chunk) {
             API_RETURN_VALUE_ASSIGN_ERROR(*this, "", EINVAL);
           }
 
+          verified_size += bytes_read;
           loc += bytes_read;
           m_progress += bytes_read;
           if (
@@ -823,6 +1368,11 @@ Link &Link::install_os(u32 image_id, const UpdateOs &options) {
           }
         }
       }
+
+      options.printer()->key(
+        "verifiedBytes",
+        var::NumberString(verified_size));
+      m_update_report.set_verify_duration(verify_timer.micro_time());
     }
 
     if (image_id != m_bootloader_attributes.hardware_id) {
@@ -883,6 +1433,10 @@ Link &Link::install_os(u32 image_id, const UpdateOs &options) {
         API_RETURN_VALUE_ASSIGN_ERROR(*this, "", EIO);
       }
     }
+
+    if (journal && is_success()) {
+      journal->remove();
+    }
   }
 
   if (progress_callback) {
@@ -893,7 +1447,8 @@ Link &Link::install_os(u32 image_id, const UpdateOs &options) {
 }
 
 Link &Link::update_os(const UpdateOs &options) {
-  API_ASSERT(options.image() != nullptr);
+  API_ASSERT(
+    options.image() != nullptr || options.image_view().size() > 0);
   API_ASSERT(options.printer() != nullptr);
 
   API_RETURN_VALUE_IF_ERROR(*this);
@@ -901,33 +1456,327 @@ Link &Link::update_os(const UpdateOs &options) {
     API_RETURN_VALUE_ASSIGN_ERROR(*this, "not connected", EBADF);
   }
 
+  m_update_report = UpdateReport();
+
+  // an image that isn't already in memory is read once
+  // then every pass works on the same view
+  fs::DataFile image_file;
+  if (options.image_view().size() == 0) {
+    if (options.image()->seek(0).is_error()) {
+      API_RETURN_VALUE_ASSIGN_ERROR(*this, "", EINVAL);
+    }
+    image_file.write(*options.image());
+  }
+
+  const var::View image = options.image_view().size() > 0
+                            ? options.image_view()
+                            : var::View(image_file.data());
+
+  API_RETURN_VALUE_IF_ERROR(*this);
+
   if (is_bootloader() == false) {
     if (options.flash_path().is_empty() == false) {
-      update_os_flash_device(options);
+      update_os_flash_device(image, options);
       return *this;
     }
 
     API_RETURN_VALUE_ASSIGN_ERROR(*this, "not bootloader", EINVAL);
   }
 
-  u32 image_id
-    = validate_os_image_id_with_connected_bootloader(options.image());
+  const u32 image_id = validate_os_image_id_with_connected_bootloader(image);
   API_RETURN_VALUE_IF_ERROR(*this);
 
+#if SOS_API_USE_CRYPTO_API
+  if (
+    options.image_store()
+    && options.image_hash().size() == sizeof(crypto::Sha256::Hash)) {
+    crypto::Sha256::Hash hash;
+    var::View(hash).copy(options.image_hash());
+    const auto entry = options.image_store()->find(hash);
+    if (entry.size() > 0) {
+      // a stale hash would apply another build's entry to this image
+      if (
+        entry.size() != image.size()
+        || var::View(crypto::Sha256::get_hash(fs::ViewFile(image)))
+             != var::View(hash)) {
+        API_RETURN_VALUE_ASSIGN_ERROR(
+          *this,
+          "image hash doesn't match the image",
+          EINVAL);
+      }
+
+      // the store already knows if the image is signed
+      if (is_signature_required() && entry.is_signed() == false) {
+        API_RETURN_VALUE_ASSIGN_ERROR(
+          *this,
+          "bootloader requires a signed image",
+          EINVAL);
+      }
+    }
+  }
+#endif
+
   const var::KeyString progress_key = options.printer()->progress_key();
 
-  erase_os(options);
-  install_os(image_id, options);
+  if (options.is_delta() && install_os_delta(image_id, image, options)) {
+    options.printer()->key_bool(
+      "unchanged",
+      m_compare_report.mismatch_list().count() == 0);
+    options.printer()->object("update", m_update_report);
+  } else if (options.journal_path().is_empty() == false) {
+    InstallJournal journal(
+      options.journal_path(),
+      m_link_info.serial_number(),
+      image,
+      options.image_hash());
+    const u32 resume_offset
+      = get_install_resume_offset(image, options, journal);
+    if (resume_offset > 0) {
+      m_update_report.set_resume_offset(resume_offset);
+    } else {
+      erase_os(options);
+    }
+    install_os(image_id, image, options, resume_offset, &journal);
+    options.printer()->object("update", m_update_report);
+  } else {
+    erase_os(options);
+    install_os(image_id, image, options);
+    options.printer()->object("update", m_update_report);
+  }
 
   options.printer()->set_progress_key(progress_key);
   return *this;
 }
 
-void Link::update_os_flash_device(const UpdateOs &options) {
+u32 Link::get_install_resume_offset(
+  var::View image,
+  const UpdateOs &options,
+  const InstallJournal &journal) {
+  API_RETURN_VALUE_IF_ERROR(0);
+
+  if (journal.size() == 0 || journal.size() > image.size()) {
+    return 0;
+  }
+
+  bootloader_attr_t attr;
+  get_bootloader_attr(attr);
+  // bootloaders from 0x400 keep the start page in RAM until the image is
+  // complete so it is lost if the install is interrupted. Bootloaders
+  // that require a signature don't allow the flash to be read back.
+  if (
+    is_error() || attr.version >= 0x400
+    || link_is_signature_required(driver(), &attr)) {
+    API_RESET_ERROR();
+    return 0;
+  }
+
+  const u32 chunk_size = get_install_chunk_size(options);
+  var::Data buffer(chunk_size);
+  var::Data expected_buffer(chunk_size);
+  var::Data erased_buffer(chunk_size);
+  var::View(erased_buffer).fill<u8>(0xff);
+
+  // returns the expected flash contents (the start page is held back)
+  auto get_expected = [&](u32 offset, u32 size) -> var::View {
+    var::View result = var::View(image).pop_front(offset).truncate(size);
+    if (offset < 256) {
+      var::View(expected_buffer).copy(result);
+      var::View(expected_buffer).truncate(256 - offset).fill<u8>(0xff);
+      result = var::View(expected_buffer).truncate(size);
+    }
+    return result;
+  };
+
+  auto read_chunk = [&](u32 offset, u32 size) -> var::View {
+    const var::View result = var::View(buffer).truncate(size);
+    return read_os_flash(offset, result) == int(size) ? result : var::View();
+  };
+
+  // the chunk before the journaled size must already be written
+  {
+    const u32 offset
+      = journal.size() > chunk_size ? journal.size() - chunk_size : 0;
+    const u32 size = journal.size() - offset;
+    if (read_chunk(offset, size) != get_expected(offset, size)) {
+      return 0;
+    }
+  }
+
+  // the journal can lag the device so written chunks are skipped
+  // until the first erased chunk
+  u32 result = journal.size();
+  while (result < image.size()) {
+    const u32 size_left = image.size() - result;
+    const u32 size = size_left > chunk_size ? chunk_size : size_left;
+    // erased chunks in the image may have been skipped (see is_sparse())
+    const var::View flash = read_chunk(result, size);
+    if (flash != get_expected(result, size)) {
+      if (flash == var::View(erased_buffer).truncate(size)) {
+        break;
+      }
+      // partially written
+      return 0;
+    }
+    result += size;
+  }
+
+  return result;
+}
+
+bool Link::install_os_delta(
+  u32 image_id,
+  var::View image,
+  const UpdateOs &options) {
+  API_RETURN_VALUE_IF_ERROR(false);
+
+  // bootloaders that require a signature do not allow reading back code
+  const bool is_readable = is_signature_required() == false;
+  if (is_error() || !is_readable) {
+    API_RESET_ERROR();
+    return false;
+  }
+
+  const u32 page_size = get_install_chunk_size(options);
+  options.printer()->set_progress_key("comparing");
+
+  compare_flash(CompareFlash()
+                  .set_image_view(image)
+                  .set_page_size(page_size)
+                  .set_progress_callback(get_progress_callback(options)));
+
+  if (
+    is_error()
+    || m_compare_report.compared_page_count()
+         != m_compare_report.page_count()) {
+    API_RESET_ERROR();
+    return false;
+  }
+
+  const u32 start_address = m_bootloader_attributes.startaddr;
+  const auto &mismatch_list = m_compare_report.mismatch_list();
+  var::Data flash_buffer(page_size);
+  var::Data image_buffer;
+
+  auto get_page_size = [&](u32 offset) {
+    const u32 size_left = image.size() - offset;
+    return size_left > page_size ? page_size : size_left;
+  };
+
+  // the bootloader can only erase the whole OS so a page can only be
+  // rewritten in place if programming it just clears bits. The start
+  // page is written last by install_os() so it always needs a full install.
+  for (const u32 address : mismatch_list) {
+    const u32 offset = address - start_address;
+    const u32 size = get_page_size(offset);
+    const var::View flash = var::View(flash_buffer).truncate(size);
+    if (offset < 256 || read_os_flash(offset, flash) != int(size)) {
+      return false;
+    }
+
+    const var::View expected
+      = get_installed_os_view(image_id, image, offset, size, image_buffer);
+    for (u32 i = 0; i < size; i++) {
+      const u8 flash_value = flash.to_const_u8()[i];
+      const u8 expected_value = expected.to_const_u8()[i];
+      if ((flash_value & expected_value) != expected_value) {
+        return false;
+      }
+    }
+  }
+
+  options.printer()->set_progress_key("installing");
+
+  const api::ProgressCallback *progress_callback
+    = get_progress_callback(options);
+
+  chrono::ClockTimer write_timer;
+  write_timer.start();
+
+  bool is_installed = true;
+  u32 page = 0;
+  for (const u32 address : mismatch_list) {
+    const u32 offset = address - start_address;
+    const u32 size = get_page_size(offset);
+    const var::View expected
+      = get_installed_os_view(image_id, image, offset, size, image_buffer);
+
+    // read back so a page that didn't program falls back to a full install
+    const var::View flash = var::View(flash_buffer).truncate(size);
+    if (
+      link_writeflash(driver(), address, expected.to_const_void(), size)
+        != int(size)
+      || read_os_flash(offset, flash) != int(size) || flash != expected) {
+      is_installed = false;
+      break;
+    }
+
+    m_update_report.set_write_count(m_update_report.write_count() + 1);
+    if (progress_callback) {
+      progress_callback->update(++page, mismatch_list.count());
+    }
+  }
+
+  m_update_report.set_write_duration(write_timer.micro_time())
+    .set_chunk_size(page_size);
+
+  options.printer()->key(
+    "changedPageCount",
+    var::NumberString(mismatch_list.count()));
 
-  validate_os_image_id_with_connected_bootloader(
-    options.image(),
-    UseBootloaderId::no);
+  if (progress_callback) {
+    progress_callback->update(0, 0);
+  }
+
+  return is_installed;
+}
+
+int Link::read_os_flash(u32 offset, var::View destination) {
+  int result = LINK_PROT_ERROR;
+  for (int tries = 0; tries < MAX_TRIES && result == LINK_PROT_ERROR;
+       tries++) {
+    result = link_readflash(
+      driver(),
+      m_bootloader_attributes.startaddr + offset,
+      destination.to_void(),
+      destination.size());
+  }
+  return result;
+}
+
+var::View Link::get_installed_os_view(
+  u32 image_id,
+  var::View image,
+  u32 offset,
+  u32 size,
+  var::Data &buffer) const {
+  const var::View result = var::View(image).pop_front(offset).truncate(size);
+
+  // install_os() corrects the hardware id when it writes the start page
+  // last which is only done for bootloaders older than 0x400
+  u32 hardware_id = m_bootloader_attributes.hardware_id;
+  const u32 id_offset = BOOTLOADER_HARDWARE_ID_OFFSET;
+  if (
+    m_bootloader_attributes.version >= 0x400 || image_id == hardware_id
+    || offset >= id_offset + sizeof(hardware_id)
+    || offset + size <= id_offset) {
+    return result;
+  }
+
+  buffer.resize(size);
+  var::View(buffer).copy(result);
+  const auto *id_data = var::View(hardware_id).to_const_u8();
+  for (u32 i = 0; i < sizeof(hardware_id); i++) {
+    const u32 position = id_offset + i;
+    if (position >= offset && position < offset + size) {
+      var::View(buffer).to_u8()[position - offset] = id_data[i];
+    }
+  }
+  return var::View(buffer);
+}
+
+void Link::update_os_flash_device(var::View image, const UpdateOs &options) {
+
+  validate_os_image_id_with_connected_bootloader(image, UseBootloaderId::no);
 
   API_RETURN_IF_ERROR();
 
@@ -939,13 +1788,21 @@ void Link::update_os_flash_device(const UpdateOs &options) {
     driver());
   API_RETURN_IF_ERROR();
 
-  erase_os_flash_device(options, flash_device);
-  install_os_flash_device(options, flash_device);
+  if (
+    options.is_delta()
+    && flash_device.ioctl(I_FLASH_IS_SIGNATURE_REQUIRED).return_value() != 1) {
+    install_os_flash_device_delta(image, options, flash_device);
+  } else {
+    erase_os_flash_device(image, options, flash_device);
+    install_os_flash_device(image, options, flash_device);
+  }
 
+  options.printer()->object("update", m_update_report);
   options.printer()->set_progress_key(progress_key);
 }
 
 void Link::erase_os_flash_device(
+  var::View image,
   const UpdateOs &options,
   const Link::File &flash_device) {
 
@@ -962,7 +1819,7 @@ void Link::erase_os_flash_device(
                .return_value();
 
   const api::ProgressCallback *progress_callback
-    = options.printer()->progress_callback();
+    = get_progress_callback(options);
 
   options.printer()->set_progress_key("erasing");
 
@@ -972,17 +1829,43 @@ void Link::erase_os_flash_device(
       api::ProgressCallback::indeterminate_progress_total());
   }
 
+  chrono::ClockTimer erase_timer;
+  erase_timer.start();
+
+  var::Data buffer;
+  u32 page_count = 0;
+  u32 erased_page_count = 0;
+
+  // the timeout covers the longest page erase
+  link_transport_mastersettimeout(driver(), 5000);
   do {
     flash_pageinfo_t page_info = {};
     page_info.page = page;
     flash_device.ioctl(I_FLASH_GETPAGEINFO, &page_info);
     size_erased += page_info.size;
 
-    link_transport_mastersettimeout(driver(), 5000);
-    flash_device.ioctl(I_FLASH_ERASEPAGE, MCU_INT_CAST(page));
-    link_transport_mastersettimeout(driver(), 0);
+    // pages that are already erased are skipped. The page is read in
+    // pieces so that one that isn't erased is usually found on the first
+    // read. If the page can't be read, it is erased anyway.
+    bool is_page_erased = true;
+    u32 page_offset = 0;
+    flash_device.seek(page_info.addr);
+    while (is_page_erased && page_offset < page_info.size) {
+      const u32 size_left = page_info.size - page_offset;
+      buffer.resize(size_left > 4096 ? 4096 : size_left);
+      flash_device.read(buffer);
+      is_page_erased = is_success() && is_erased(buffer);
+      page_offset += buffer.size();
+    }
+
+    if (is_page_erased == false) {
+      API_RESET_ERROR();
+      flash_device.ioctl(I_FLASH_ERASEPAGE, MCU_INT_CAST(page));
+      erased_page_count++;
+    }
 
     page++;
+    page_count++;
 
     if (progress_callback) {
       progress_callback->update(
@@ -990,7 +1873,13 @@ void Link::erase_os_flash_device(
         api::ProgressCallback::indeterminate_progress_total());
     }
 
-  } while (size_erased < options.image()->size());
+  } while (size_erased < image.size() && is_success());
+  link_transport_mastersettimeout(driver(), 0);
+
+  m_update_report.set_erase_duration(erase_timer.micro_time());
+  options.printer()
+    ->key("pageCount", var::NumberString(page_count))
+    .key("erasedPageCount", var::NumberString(erased_page_count));
 
   if (progress_callback) {
     progress_callback->update(0, 0);
@@ -998,6 +1887,7 @@ void Link::erase_os_flash_device(
 }
 
 void Link::install_os_flash_device(
+  var::View image,
   const UpdateOs &options,
   const File &flash_device) {
 
@@ -1010,7 +1900,7 @@ void Link::install_os_flash_device(
   }();
 
   const api::ProgressCallback *progress_callback
-    = options.printer()->progress_callback();
+    = get_progress_callback(options);
 
   if (progress_callback) {
     options.printer()->set_progress_key("installing");
@@ -1020,24 +1910,37 @@ void Link::install_os_flash_device(
     = flash_device.ioctl(I_FLASH_IS_SIGNATURE_REQUIRED).return_value()
       == 1;
 
-  const u32 image_size = options.image()->size();
+  const u32 image_size = image.size();
   const u32 install_size = is_signature_required
                              ? image_size - sizeof(auth_signature_marker_t)
                              : image_size;
   u32 size_processed = 0;
 
+  chrono::ClockTimer write_timer;
+  write_timer.start();
+
   do {
     flash_writepage_t write_page;
     const auto size_left = install_size - size_processed;
     const u32 page_size
       = size_left > sizeof(write_page.buf) ? sizeof(write_page.buf) : size_left;
 
-    options.image()->read(var::View(write_page.buf, page_size));
-    write_page.addr = os_info.start + size_processed;
-    write_page.nbyte = page_size;
-    flash_device.ioctl(I_FLASH_WRITEPAGE, &write_page);
-    if (is_error()) {
-      break;
+    const var::View image_page
+      = var::View(image).pop_front(size_processed).truncate(page_size);
+
+    // the flash is erased so erased data doesn't need to be written
+    if (is_erased(image_page) == false) {
+      var::View(write_page.buf, page_size).copy(image_page);
+      write_page.addr = os_info.start + size_processed;
+      write_page.nbyte = page_size;
+      flash_device.ioctl(I_FLASH_WRITEPAGE, &write_page);
+      if (is_error()) {
+        break;
+      }
+      m_update_report.set_write_count(m_update_report.write_count() + 1);
+    } else {
+      m_update_report.set_skipped_size(
+        m_update_report.skipped_size() + page_size);
     }
 
     size_processed += page_size;
@@ -1048,11 +1951,19 @@ void Link::install_os_flash_device(
 
   } while (size_processed < install_size);
 
+  const u64 write_microseconds = write_timer.micro_time().microseconds();
+  m_update_report.set_write_duration(write_timer.micro_time())
+    .set_chunk_size(sizeof(flash_writepage_t::buf))
+    .set_bytes_per_second(
+      write_microseconds
+        ? u32(u64(size_processed) * 1000000 / write_microseconds)
+        : 0);
+
   if (is_signature_required) {
-    const auto signature_info
-      = Auth::get_signature_info(options.image()->seek(0));
+    // only the marker is needed -- the image doesn't need to be hashed
+    const auto image_signature = Auth::get_signature(fs::ViewFile(image));
     auth_signature_t signature = {};
-    View(signature).copy(signature_info.signature().data());
+    View(signature).copy(image_signature.data());
     flash_device.ioctl(I_FLASH_VERIFY_SIGNATURE, &signature);
   }
 
@@ -1061,6 +1972,384 @@ void Link::install_os_flash_device(
   }
 }
 
+void Link::install_os_flash_device_delta(
+  var::View image,
+  const UpdateOs &options,
+  const File &flash_device) {
+
+  API_RETURN_IF_ERROR();
+
+  const flash_os_info_t os_info = [&]() {
+    flash_os_info_t result = {};
+    flash_device.ioctl(I_FLASH_GETOSINFO, &result);
+    return result;
+  }();
+
+  int page = flash_device.ioctl(I_FLASH_GET_PAGE, MCU_INT_CAST(os_info.start))
+               .return_value();
+
+  const api::ProgressCallback *progress_callback
+    = get_progress_callback(options);
+
+  options.printer()->set_progress_key("installing");
+
+  var::Data buffer;
+  u32 page_count = 0;
+  u32 changed_page_count = 0;
+  u32 size_processed = 0;
+
+  chrono::ClockTimer write_timer;
+  write_timer.start();
+
+  // the timeout covers the longest page erase
+  link_transport_mastersettimeout(driver(), 5000);
+  while (size_processed < image.size() && is_success()) {
+    flash_pageinfo_t page_info = {};
+    page_info.page = page++;
+    flash_device.ioctl(I_FLASH_GETPAGEINFO, &page_info);
+
+    const u32 size_left = image.size() - size_processed;
+    const u32 page_size = size_left > page_info.size ? page_info.size : size_left;
+    const var::View image_page
+      = var::View(image).pop_front(size_processed).truncate(page_size);
+
+    buffer.resize(page_size);
+    flash_device.seek(os_info.start + size_processed).read(buffer);
+    page_count++;
+
+    if (is_success() && var::View(buffer) != image_page) {
+      changed_page_count++;
+
+      flash_device.ioctl(I_FLASH_ERASEPAGE, MCU_INT_CAST(page_info.page));
+
+      u32 page_offset = 0;
+      while (page_offset < page_size && is_success()) {
+        flash_writepage_t write_page;
+        const u32 write_size_left = page_size - page_offset;
+        const u32 write_size = write_size_left > sizeof(write_page.buf)
+                                 ? sizeof(write_page.buf)
+                                 : write_size_left;
+
+        const var::View image_chunk
+          = var::View(image_page).pop_front(page_offset).truncate(write_size);
+        if (is_erased(image_chunk) == false) {
+          var::View(write_page.buf, write_size).copy(image_chunk);
+          write_page.addr = os_info.start + size_processed + page_offset;
+          write_page.nbyte = write_size;
+          flash_device.ioctl(I_FLASH_WRITEPAGE, &write_page);
+          m_update_report.set_write_count(m_update_report.write_count() + 1);
+        } else {
+          m_update_report.set_skipped_size(
+            m_update_report.skipped_size() + write_size);
+        }
+        page_offset += write_size;
+      }
+    }
+
+    size_processed += page_size;
+    if (progress_callback) {
+      progress_callback->update(size_processed, image.size());
+    }
+  }
+  link_transport_mastersettimeout(driver(), 0);
+
+  m_update_report.set_write_duration(write_timer.micro_time())
+    .set_chunk_size(sizeof(flash_writepage_t::buf));
+
+  options.printer()
+    ->key("pageCount", var::NumberString(page_count))
+    .key("changedPageCount", var::NumberString(changed_page_count));
+
+  if (progress_callback) {
+    progress_callback->update(0, 0);
+  }
+}
+
+Link &Link::dump_flash(const DumpFlash &options) {
+  API_RETURN_VALUE_IF_ERROR(*this);
+
+  if (options.file() == nullptr || options.size() == 0) {
+    API_RETURN_VALUE_ASSIGN_ERROR(*this, "no file or size to dump", EINVAL);
+  }
+
+  if (is_bootloader() == false) {
+    API_RETURN_VALUE_ASSIGN_ERROR(
+      *this,
+      "flash can only be dumped by the bootloader",
+      EINVAL);
+  }
+
+  if (is_signature_required()) {
+    API_RETURN_VALUE_ASSIGN_ERROR(
+      *this,
+      "bootloader doesn't allow reading flash",
+      EPERM);
+  }
+
+  const u32 page_size = options.page_size() ? options.page_size()
+                                            : u32(UpdateOs::minimum_chunk_size);
+  const u32 chunk_size = [&]() {
+    const u32 result = options.chunk_size() - options.chunk_size() % page_size;
+    if (result < page_size) {
+      return page_size;
+    }
+    return result > UpdateOs::maximum_chunk_size
+             ? u32(UpdateOs::maximum_chunk_size)
+                 - u32(UpdateOs::maximum_chunk_size) % page_size
+             : result;
+  }();
+
+  const api::ProgressCallback *progress_callback
+    = options.progress_callback()
+        ? options.progress_callback()
+        : (options.printer() ? options.printer()->progress_callback() : nullptr);
+
+  if (options.printer()) {
+    options.printer()->set_progress_key("dumping");
+  }
+
+  const fs::FileObject &file = *options.file();
+  var::Data buffer(chunk_size);
+  chrono::ClockTimer read_timer;
+  read_timer.start();
+
+  if (options.manifest()) {
+    const auto header = var::GeneralString().format(
+      "# <address> <%s|erased> per %ld byte page\n"
+      "# erased pages are 0xff on the device%s\n",
+      page_hash_name,
+      long(page_size),
+      options.is_sparse() ? " but holes in the dump read back as 0x00"
+                          : "");
+    options.manifest()->write(var::View(header.string_view()));
+  }
+
+  u32 offset = 0;
+  u32 erased_size = 0;
+  while (offset < options.size() && is_success()) {
+    const u32 size_left = options.size() - offset;
+    const int size = size_left > chunk_size ? chunk_size : size_left;
+    const u32 address = options.address() + offset;
+
+    int result = LINK_PROT_ERROR;
+    for (int tries = 0; tries < MAX_TRIES && result == LINK_PROT_ERROR;
+         tries++) {
+      result = link_readflash(driver(), address, buffer.data(), size);
+    }
+
+    if (result != size) {
+      if (progress_callback) {
+        progress_callback->update(0, 0);
+      }
+      API_RETURN_VALUE_ASSIGN_ERROR(
+        *this,
+        "failed to read flash with result " | get_device_result_error(result),
+        EIO);
+    }
+
+    u32 page_offset = 0;
+    while (page_offset < u32(size) && is_success()) {
+      const u32 page_left = u32(size) - page_offset;
+      const var::View page
+        = var::View(buffer).pop_front(page_offset).truncate(
+          page_left > page_size ? page_size : page_left);
+      const u32 page_end = offset + page_offset + page.size();
+      const bool is_page_erased = is_erased(page);
+
+      // the last page is always written so the file has the full size
+      if (options.is_sparse() && is_page_erased && page_end < options.size()) {
+        file.seek(page.size(), fs::File::Whence::current);
+      } else {
+        file.write(page);
+      }
+
+      if (is_page_erased) {
+        erased_size += page.size();
+      }
+
+      if (options.manifest()) {
+        const auto line = var::GeneralString().format(
+          "0x%08lx %s\n",
+          static_cast<unsigned long>(address + page_offset),
+          is_page_erased ? "erased" : get_page_hash(page).cstring());
+        options.manifest()->write(var::View(line.string_view()));
+      }
+
+      page_offset += page.size();
+    }
+
+    offset += size;
+    if (progress_callback) {
+      progress_callback->update(offset, options.size());
+    }
+  }
+
+  if (progress_callback) {
+    progress_callback->update(0, 0);
+  }
+
+  API_RETURN_VALUE_IF_ERROR(*this);
+
+  if (options.printer()) {
+    const u64 read_microseconds = read_timer.micro_time().microseconds();
+    options.printer()
+      ->key("dumpedSize", var::NumberString(offset))
+      .key("erasedSize", var::NumberString(erased_size))
+      .key(
+        "bytesPerSecond",
+        var::NumberString(
+          read_microseconds ? u32(u64(offset) * 1000000 / read_microseconds)
+                            : 0));
+  }
+
+  return *this;
+}
+
+Link &Link::compare_flash(const CompareFlash &options) {
+  API_ASSERT(
+    options.image() != nullptr || options.image_view().size() > 0);
+
+  API_RETURN_VALUE_IF_ERROR(*this);
+  m_compare_report = CompareReport();
+
+  if (is_bootloader() == false) {
+    API_RETURN_VALUE_ASSIGN_ERROR(
+      *this,
+      "flash can only be compared by the bootloader",
+      EINVAL);
+  }
+
+  if (is_signature_required()) {
+    API_RETURN_VALUE_ASSIGN_ERROR(
+      *this,
+      "bootloader doesn't allow reading flash",
+      EPERM);
+  }
+
+  fs::DataFile image_file;
+  if (options.image_view().size() == 0) {
+    if (options.image()->seek(0).is_error()) {
+      API_RETURN_VALUE_ASSIGN_ERROR(*this, "", EINVAL);
+    }
+    image_file.write(*options.image());
+  }
+
+  const var::View image = options.image_view().size() > 0
+                            ? options.image_view()
+                            : var::View(image_file.data());
+
+  const u32 image_id = validate_os_image_id_with_connected_bootloader(image);
+  API_RETURN_VALUE_IF_ERROR(*this);
+
+  const u32 page_size = options.page_size() ? options.page_size()
+                                            : u32(UpdateOs::minimum_chunk_size);
+  const u32 sample_interval
+    = options.sample_interval() ? options.sample_interval() : 1;
+  // sampled starting at a random page so repeated checks cover the image
+  const u32 sample_phase = get_random_value() % sample_interval;
+  const u32 page_count = (image.size() + page_size - 1) / page_size;
+  const u32 start_address = m_bootloader_attributes.startaddr;
+  // consecutive pages are read together up to this many
+  const u32 pages_per_read
+    = page_size < UpdateOs::maximum_chunk_size
+        ? u32(UpdateOs::maximum_chunk_size) / page_size
+        : 1;
+
+  auto is_sampled = [&](u32 page) {
+    return page == 0 || page == page_count - 1
+           || page % sample_interval == sample_phase;
+  };
+
+  const api::ProgressCallback *progress_callback
+    = options.progress_callback()
+        ? options.progress_callback()
+        : (options.printer() ? options.printer()->progress_callback() : nullptr);
+
+  if (options.printer()) {
+    options.printer()->set_progress_key("comparing");
+  }
+
+  m_compare_report.set_address(start_address)
+    .set_page_size(page_size)
+    .set_sample_interval(sample_interval)
+    .set_page_count(page_count);
+
+  var::Data buffer(page_size * pages_per_read);
+  var::Data start_buffer;
+  var::Vector<u32> mismatch_list;
+  u32 compared_page_count = 0;
+
+  u32 page = 0;
+  while (page < page_count && is_success()
+         && !(options.is_stop_at_mismatch() && mismatch_list.count())) {
+    if (is_sampled(page) == false) {
+      page++;
+      continue;
+    }
+
+    u32 run_count = 1;
+    while (run_count < pages_per_read && page + run_count < page_count
+           && is_sampled(page + run_count)) {
+      run_count++;
+    }
+
+    const u32 offset = page * page_size;
+    const u32 size_left = image.size() - offset;
+    const int size
+      = size_left > run_count * page_size ? run_count * page_size : size_left;
+
+    const int result = read_os_flash(offset, var::View(buffer).truncate(size));
+    if (result != size) {
+      if (progress_callback) {
+        progress_callback->update(0, 0);
+      }
+      API_RETURN_VALUE_ASSIGN_ERROR(
+        *this,
+        "failed to read flash with result " | get_device_result_error(result),
+        EIO);
+    }
+
+    for (u32 i = 0; i < run_count; i++) {
+      const u32 page_offset = i * page_size;
+      const u32 page_left = u32(size) - page_offset;
+      const u32 compare_size = page_left > page_size ? page_size : page_left;
+      const var::View image_page = get_installed_os_view(
+        image_id,
+        image,
+        offset + page_offset,
+        compare_size,
+        start_buffer);
+
+      if (
+        var::View(buffer).pop_front(page_offset).truncate(compare_size)
+        != image_page) {
+        mismatch_list.push_back(start_address + offset + page_offset);
+      }
+      compared_page_count++;
+    }
+
+    page += run_count;
+    if (progress_callback) {
+      progress_callback->update(page, page_count);
+    }
+  }
+
+  if (progress_callback) {
+    progress_callback->update(0, 0);
+  }
+
+  API_RETURN_VALUE_IF_ERROR(*this);
+
+  m_compare_report.set_compared_page_count(compared_page_count)
+    .set_mismatch_list(mismatch_list);
+
+  if (options.printer()) {
+    options.printer()->object("compare", m_compare_report);
+  }
+
+  return *this;
+}
+
 var::NumberString Link::get_device_result_error(s32 result) {
   const int error_number = SYSFS_GET_RETURN_ERRNO(result);
   const int return_value = SYSFS_GET_RETURN(result);
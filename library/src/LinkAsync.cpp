@@ -0,0 +1,166 @@
+// Copyright 2016-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#if defined __link
+
+#include "sos/LinkAsync.hpp"
+
+using namespace sos;
+
+LinkAsync::PathArgument LinkAsync::get_path_argument(var::StringView path) {
+  PathArgument result = {};
+  if (path.length() >= sizeof(result.path)) {
+    API_RETURN_VALUE_ASSIGN_ERROR(result, "path is too long", ENAMETOOLONG);
+  }
+  var::View(result.path).truncate(sizeof(result.path) - 1).copy(path);
+  result.is_legacy = Link::IsLegacy::no;
+  return result;
+}
+
+var::Data LinkAsync::get_memory_argument(
+  var::StringView path,
+  int offset,
+  void *destination,
+  var::View source) {
+  MemoryArgument argument = {};
+  if (path.length() >= sizeof(argument.path)) {
+    API_RETURN_VALUE_ASSIGN_ERROR(
+      var::Data(),
+      "path is too long",
+      ENAMETOOLONG);
+  }
+  var::View(argument.path).truncate(sizeof(argument.path) - 1).copy(path);
+  argument.offset = offset;
+  argument.destination = destination;
+  argument.size = static_cast<int>(source.size());
+
+  var::Data result(sizeof(MemoryArgument) + source.size());
+  var::View(result).copy(var::View(argument));
+  if (source.size()) {
+    var::View(result).pop_front(sizeof(MemoryArgument)).copy(source);
+  }
+  return result;
+}
+
+LinkAsync::Future
+LinkAsync::connect(var::StringView path, Link::IsLegacy is_legacy) {
+  auto argument = get_path_argument(path);
+  API_RETURN_VALUE_IF_ERROR(Future());
+  argument.is_legacy = is_legacy;
+  return m_pool->submit(
+    m_device_index,
+    [](Link &link, void *argument) {
+      const auto *path_argument = reinterpret_cast<PathArgument *>(argument);
+      if (link.is_connected()) {
+        link.disconnect();
+      }
+      link.connect(path_argument->path, path_argument->is_legacy);
+    },
+    var::View(argument),
+    LinkPool::IsAutoConnect::no);
+}
+
+LinkAsync::Future LinkAsync::disconnect() {
+  return m_pool->submit(
+    m_device_index,
+    [](Link &link, void *) { link.disconnect(); },
+    var::View(),
+    LinkPool::IsAutoConnect::no);
+}
+
+LinkAsync::Future LinkAsync::read_flash(int address, var::View destination) {
+  MemoryArgument argument = {};
+  argument.offset = address;
+  argument.destination = destination.to_void();
+  argument.size = static_cast<int>(destination.size());
+  return submit(
+    [](Link &link, void *argument) {
+      const auto *memory = reinterpret_cast<MemoryArgument *>(argument);
+      link.read_flash(memory->offset, memory->destination, memory->size);
+    },
+    var::View(argument));
+}
+
+LinkAsync::Future LinkAsync::write_flash(int address, var::View source) {
+  const auto argument = get_memory_argument("", address, nullptr, source);
+  API_RETURN_VALUE_IF_ERROR(Future());
+  return submit(
+    [](Link &link, void *argument) {
+      const auto *memory = reinterpret_cast<MemoryArgument *>(argument);
+      link.write_flash(memory->offset, memory + 1, memory->size);
+    },
+    argument);
+}
+
+LinkAsync::Future LinkAsync::get_time(struct tm *destination) {
+  MemoryArgument argument = {};
+  argument.destination = destination;
+  argument.size = sizeof(struct tm);
+  return submit(
+    [](Link &link, void *argument) {
+      const auto *memory = reinterpret_cast<MemoryArgument *>(argument);
+      link.get_time(reinterpret_cast<struct tm *>(memory->destination));
+    },
+    var::View(argument));
+}
+
+LinkAsync::Future LinkAsync::run_app(var::StringView path) {
+  const auto argument = get_path_argument(path);
+  API_RETURN_VALUE_IF_ERROR(Future());
+  return submit(
+    [](Link &link, void *argument) {
+      link.run_app(reinterpret_cast<PathArgument *>(argument)->path);
+    },
+    var::View(argument));
+}
+
+LinkAsync::Future LinkAsync::format(var::StringView path) {
+  const auto argument = get_path_argument(path);
+  API_RETURN_VALUE_IF_ERROR(Future());
+  return submit(
+    [](Link &link, void *argument) {
+      link.format(reinterpret_cast<PathArgument *>(argument)->path);
+    },
+    var::View(argument));
+}
+
+LinkAsync::Future LinkAsync::read_file(
+  var::StringView path,
+  int offset,
+  var::View destination) {
+  MemoryArgument argument = {};
+  if (path.length() >= sizeof(argument.path)) {
+    API_RETURN_VALUE_ASSIGN_ERROR(Future(), "path is too long", ENAMETOOLONG);
+  }
+  var::View(argument.path).truncate(sizeof(argument.path) - 1).copy(path);
+  argument.offset = offset;
+  argument.destination = destination.to_void();
+  argument.size = static_cast<int>(destination.size());
+  return submit(
+    [](Link &link, void *argument) {
+      const auto *memory = reinterpret_cast<MemoryArgument *>(argument);
+      Link::File(memory->path, fs::OpenMode::read_only(), link.driver())
+        .seek(memory->offset)
+        .read(var::View(memory->destination, memory->size));
+    },
+    var::View(argument));
+}
+
+LinkAsync::Future LinkAsync::write_file(
+  var::StringView path,
+  int offset,
+  var::View source) {
+  const auto argument = get_memory_argument(path, offset, nullptr, source);
+  API_RETURN_VALUE_IF_ERROR(Future());
+  return submit(
+    [](Link &link, void *argument) {
+      const auto *memory = reinterpret_cast<MemoryArgument *>(argument);
+      Link::File(memory->path, fs::OpenMode::read_write(), link.driver())
+        .seek(memory->offset)
+        .write(var::View(memory + 1, memory->size));
+    },
+    argument);
+}
+
+#else
+int sos_api_link_async_unused;
+#endif
@@ -0,0 +1,141 @@
+// Copyright 2016-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#if defined __link
+
+#include <chrono/DateTime.hpp>
+#include <fs/File.hpp>
+#include <fs/FileSystem.hpp>
+
+#include "sos/Link.hpp"
+
+using namespace sos;
+
+Link::InfoCache::InfoCache(var::StringView path) : m_path(path) {
+  // a missing or stale cache is not an error -- it is just empty
+  api::ErrorScope error_scope;
+
+  if (fs::FileSystem().exists(m_path) == false) {
+    return;
+  }
+
+  fs::File file(m_path);
+  u32 version = 0;
+  u32 count = 0;
+  file.read(var::View(version)).read(var::View(count));
+  if (is_error() || version != file_version) {
+    return;
+  }
+
+  m_entry_list.reserve(count);
+  for (u32 i = 0; i < count; i++) {
+    Record record = {};
+    if (
+      file.read(var::View(record)).return_value()
+      != static_cast<int>(sizeof(Record))) {
+      break;
+    }
+    record.path[path_capacity - 1] = 0;
+    m_entry_list.push_back(
+      Entry()
+        .set_info(Info(record.path, record.sys_info))
+        .set_last_seen(record.last_seen)
+        .set_erase_duration(
+          chrono::MicroTime(u64(record.erase_milliseconds) * 1000)));
+  }
+}
+
+Link::InfoCache::~InfoCache() {
+  api::ErrorGuard error_guard;
+  if (m_is_dirty) {
+    save();
+  }
+}
+
+int Link::InfoCache::find_offset(const SerialNumber &serial_number) const {
+  for (u32 i = 0; i < m_entry_list.count(); i++) {
+    if (m_entry_list.at(i).info().serial_number() == serial_number) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+Link::InfoCache::Entry
+Link::InfoCache::find(const SerialNumber &serial_number) const {
+  const int offset = find_offset(serial_number);
+  return offset < 0 ? Entry() : m_entry_list.at(offset);
+}
+
+Link::InfoCache &Link::InfoCache::update(const Info &info) {
+  if (info.serial_number().is_valid() == false) {
+    return *this;
+  }
+
+  if (info.path().length() >= path_capacity) {
+    return *this;
+  }
+
+  const auto entry = Entry().set_info(info).set_last_seen(
+    static_cast<u32>(chrono::DateTime::get_system_time().ctime()));
+
+  const int offset = find_offset(info.serial_number());
+  if (offset < 0) {
+    m_entry_list.push_back(entry);
+  } else {
+    const auto erase_duration = m_entry_list.at(offset).erase_duration();
+    m_entry_list.at(offset) = entry;
+    m_entry_list.at(offset).set_erase_duration(erase_duration);
+  }
+  m_is_dirty = true;
+  return *this;
+}
+
+Link::InfoCache &Link::InfoCache::update_erase_duration(
+  const SerialNumber &serial_number,
+  const chrono::MicroTime &duration) {
+  const int offset = find_offset(serial_number);
+  if (offset >= 0) {
+    m_entry_list.at(offset).set_erase_duration(duration);
+    m_is_dirty = true;
+  }
+  return *this;
+}
+
+Link::InfoCache &Link::InfoCache::remove(const SerialNumber &serial_number) {
+  const int offset = find_offset(serial_number);
+  if (offset >= 0) {
+    m_entry_list.remove(offset);
+    m_is_dirty = true;
+  }
+  return *this;
+}
+
+Link::InfoCache &Link::InfoCache::save() {
+  API_RETURN_VALUE_IF_ERROR(*this);
+  const u32 version = file_version;
+  const u32 count = m_entry_list.count();
+
+  fs::File file(fs::File::IsOverwrite::yes, m_path);
+  file.write(var::View(version)).write(var::View(count));
+
+  for (const auto &entry : m_entry_list) {
+    Record record = {};
+    var::View(record.path)
+      .truncate(path_capacity - 1)
+      .copy(entry.info().path().string_view());
+    record.sys_info = entry.info().sys_info();
+    record.last_seen = entry.last_seen();
+    record.erase_milliseconds
+      = static_cast<u32>(entry.erase_duration().microseconds() / 1000);
+    file.write(var::View(record));
+  }
+
+  if (is_success()) {
+    m_is_dirty = false;
+  }
+  return *this;
+}
+
+#else
+int sos_api_link_info_cache_unused;
+#endif
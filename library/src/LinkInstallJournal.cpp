@@ -0,0 +1,109 @@
+// Copyright 2016-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#if defined __link
+
+#if SOS_API_USE_CRYPTO_API
+#include <crypto/Sha256.hpp>
+#include <fs/ViewFile.hpp>
+#endif
+#include <fs/File.hpp>
+#include <fs/FileSystem.hpp>
+
+#include "sos/Link.hpp"
+
+using namespace sos;
+
+Link::InstallJournal::InstallJournal(
+  var::StringView path,
+  const SerialNumber &serial_number,
+  var::View image,
+  var::View image_hash)
+  : m_path(path) {
+
+  for (u32 i = 0; i < 4; i++) {
+    m_record.serial_number[i] = serial_number.at(i);
+  }
+
+  if (image_hash.size() == sizeof(m_record.hash)) {
+    var::View(m_record.hash).copy(image_hash);
+  } else {
+#if SOS_API_USE_CRYPTO_API
+    const auto hash = crypto::Sha256::get_hash(fs::ViewFile(image));
+    var::View(m_record.hash).copy(var::View(hash));
+#else
+    // without the crypto API, images are told apart by
+    // their size and a 64-bit FNV-1a hash
+    u64 hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < image.size(); i++) {
+      hash = (hash ^ image.to_const_u8()[i]) * 0x100000001b3ULL;
+    }
+    const u64 size = image.size();
+    var::View(m_record.hash).copy(var::View(hash));
+    var::View(m_record.hash).pop_front(sizeof(hash)).copy(var::View(size));
+#endif
+  }
+
+  // a missing or stale journal is not an error -- it is just empty
+  api::ErrorScope error_scope;
+
+  if (fs::FileSystem().exists(m_path) == false) {
+    return;
+  }
+
+  fs::File file(m_path);
+  u32 version = 0;
+  u32 count = 0;
+  file.read(var::View(version)).read(var::View(count));
+  if (is_error() || version != file_version) {
+    return;
+  }
+
+  for (u32 i = 0; i < count; i++) {
+    Record record = {};
+    if (
+      file.read(var::View(record)).return_value()
+      != static_cast<int>(sizeof(Record))) {
+      break;
+    }
+
+    if (
+      var::View(record.serial_number)
+      != var::View(m_record.serial_number)) {
+      m_record_list.push_back(record);
+    } else if (var::View(record.hash) == var::View(m_record.hash)) {
+      m_record.size = record.size;
+    }
+    // a record for the same device with a different image is dropped
+  }
+}
+
+Link::InstallJournal &Link::InstallJournal::set_size(u32 value) {
+  m_record.size = value;
+  save();
+  return *this;
+}
+
+Link::InstallJournal &Link::InstallJournal::remove() {
+  return set_size(0);
+}
+
+void Link::InstallJournal::save() {
+  API_RETURN_IF_ERROR();
+  const u32 version = file_version;
+  const u32 count = m_record_list.count() + (m_record.size ? 1 : 0);
+
+  fs::File file(fs::File::IsOverwrite::yes, m_path);
+  file.write(var::View(version)).write(var::View(count));
+
+  for (const auto &record : m_record_list) {
+    file.write(var::View(record));
+  }
+
+  if (m_record.size) {
+    file.write(var::View(m_record));
+  }
+}
+
+#else
+int sos_api_link_install_journal_unused;
+#endif
@@ -0,0 +1,67 @@
+// Copyright 2016-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#if defined __link
+
+#if !defined __win32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <fs/DataFile.hpp>
+#include <fs/File.hpp>
+
+#include "sos/Link.hpp"
+
+using namespace sos;
+
+Link::MappedImage::MappedImage(var::StringView path) {
+  API_RETURN_IF_ERROR();
+  const var::PathString path_string(path);
+
+#if defined __win32
+  m_file_data = fs::DataFile().write(fs::File(path_string)).data();
+  API_RETURN_IF_ERROR();
+  m_data = m_file_data.data();
+  m_size = m_file_data.size();
+#else
+  const int fd = ::open(path_string.cstring(), O_RDONLY);
+  if (fd < 0) {
+    API_SYSTEM_CALL(path_string.cstring(), fd);
+    return;
+  }
+
+  struct stat st = {};
+  if (::fstat(fd, &st) < 0) {
+    API_SYSTEM_CALL(path_string.cstring(), -1);
+    ::close(fd);
+    return;
+  }
+
+  if (st.st_size > 0) {
+    void *data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      API_SYSTEM_CALL(path_string.cstring(), -1);
+    } else {
+      m_data = data;
+      m_size = st.st_size;
+    }
+  }
+
+  // the mapping stays valid after the file is closed
+  ::close(fd);
+#endif
+}
+
+Link::MappedImage::~MappedImage() {
+#if !defined __win32
+  if (m_data != nullptr) {
+    ::munmap(const_cast<void *>(m_data), m_size);
+  }
+#endif
+}
+
+#else
+int sos_api_link_mapped_image_unused;
+#endif
@@ -0,0 +1,227 @@
+// Copyright 2016-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#if defined __link
+
+#include <chrono.hpp>
+
+#include "sos/LinkMonitor.hpp"
+
+using namespace sos;
+
+namespace {
+bool is_in_list(const fs::PathList &list, var::StringView path) {
+  for (const auto &item : list) {
+    if (item == path) {
+      return true;
+    }
+  }
+  return false;
+}
+} // namespace
+
+LinkMonitor::LinkMonitor(const Construct &options)
+  : m_construct(options), m_event_cond(m_mutex) {
+  if (options.driver()) {
+    m_link.set_driver(options.driver());
+  }
+  m_link.disregard_connection();
+
+  m_thread = thread::Thread(
+    thread::Thread::Attributes().set_detach_state(
+      thread::Thread::DetachState::joinable),
+    thread::Thread::Construct().set_argument(this).set_function(
+      monitor_function));
+}
+
+LinkMonitor::~LinkMonitor() {
+  {
+    thread::Mutex::Scope mutex_scope(m_mutex);
+    m_is_stop = true;
+    m_event_cond.broadcast();
+  }
+  m_thread.join();
+}
+
+LinkMonitor::Event LinkMonitor::get_event() {
+  thread::Mutex::Scope mutex_scope(m_mutex);
+  if (m_event_list.count() == 0) {
+    return Event();
+  }
+  const Event result = m_event_list.front();
+  m_event_list.remove(0);
+  return result;
+}
+
+LinkMonitor::Event LinkMonitor::wait_event() {
+  thread::Mutex::Scope mutex_scope(m_mutex);
+  while (m_event_list.count() == 0 && !m_is_stop) {
+    m_event_cond.wait();
+  }
+
+  if (m_event_list.count() == 0) {
+    return Event();
+  }
+
+  const Event result = m_event_list.front();
+  m_event_list.remove(0);
+  return result;
+}
+
+Link::InfoList LinkMonitor::get_info_list() {
+  Link::InfoList result;
+  thread::Mutex::Scope mutex_scope(m_mutex);
+  for (const auto &entry : m_entry_list) {
+    if (entry.is_attached) {
+      result.push_back(entry.info);
+    }
+  }
+  return result;
+}
+
+u32 LinkMonitor::dropped_event_count() {
+  thread::Mutex::Scope mutex_scope(m_mutex);
+  return m_dropped_event_count;
+}
+
+LinkMonitor::PathDiff LinkMonitor::get_path_diff(
+  const fs::PathList &previous,
+  const fs::PathList &current) {
+  PathDiff result;
+  for (const auto &path : previous) {
+    if (is_in_list(current, path) == false) {
+      result.removed_list().push_back(path);
+    }
+  }
+
+  for (const auto &path : current) {
+    if (is_in_list(previous, path) == false) {
+      result.added_list().push_back(path);
+    }
+  }
+  return result;
+}
+
+bool LinkMonitor::is_stop() {
+  thread::Mutex::Scope mutex_scope(m_mutex);
+  return m_is_stop;
+}
+
+void LinkMonitor::emit(const Event &event) {
+  if (m_construct.callback()) {
+    m_construct.callback()(event, m_construct.context());
+    return;
+  }
+
+  thread::Mutex::Scope mutex_scope(m_mutex);
+  const u32 maximum_event_count
+    = m_construct.maximum_event_count() ? m_construct.maximum_event_count() : 1;
+  while (m_event_list.count() >= maximum_event_count) {
+    m_event_list.remove(0);
+    m_dropped_event_count++;
+  }
+  m_event_list.push_back(event);
+  m_event_cond.signal();
+}
+
+void *LinkMonitor::monitor_function(void *args) {
+  reinterpret_cast<LinkMonitor *>(args)->run_monitor();
+  return nullptr;
+}
+
+void LinkMonitor::run_monitor() {
+  // only this thread modifies m_entry_list so it can be read
+  // here without the mutex -- changes are made with the mutex held
+  chrono::ClockTimer timer;
+  timer.start();
+
+  auto find_entry = [&](var::StringView path) -> Entry * {
+    for (auto &entry : m_entry_list) {
+      if (entry.path == path) {
+        return &entry;
+      }
+    }
+    return nullptr;
+  };
+
+  while (is_stop() == false) {
+    const auto path_list = m_link.get_path_list();
+
+    fs::PathList entry_path_list;
+    for (const auto &entry : m_entry_list) {
+      entry_path_list.push_back(entry.path);
+    }
+    const auto path_diff = get_path_diff(entry_path_list, path_list);
+
+    var::Vector<Event> detached_list;
+    {
+      var::Vector<Entry> present_list;
+      for (const auto &entry : m_entry_list) {
+        if (is_in_list(path_diff.removed_list(), entry.path) == false) {
+          present_list.push_back(entry);
+        } else if (entry.is_attached) {
+          detached_list.push_back(
+            Event().set_type(Type::detached).set_info(entry.info));
+        }
+      }
+
+      for (const auto &path : path_diff.added_list()) {
+        Entry entry;
+        entry.path = path;
+        present_list.push_back(entry);
+      }
+
+      thread::Mutex::Scope mutex_scope(m_mutex);
+      m_entry_list = present_list;
+    }
+
+    for (const auto &event : detached_list) {
+      emit(event);
+    }
+
+    for (const auto &path : path_list) {
+      if (is_stop()) {
+        return;
+      }
+
+      const u64 now = timer.micro_time().microseconds();
+      const Entry *entry = find_entry(path);
+      if (
+        entry == nullptr || entry->is_attached
+        || (entry->is_probed
+            && (now - entry->probe_timestamp
+                < m_construct.probe_interval().microseconds()))) {
+        continue;
+      }
+
+      m_link.connect(path);
+      const bool is_attached = is_success();
+      const Link::Info info
+        = is_attached ? Link::Info(path, m_link.info().sys_info())
+                      : Link::Info();
+      if (is_attached) {
+        m_link.disconnect();
+      } else {
+        API_RESET_ERROR();
+      }
+
+      {
+        thread::Mutex::Scope mutex_scope(m_mutex);
+        Entry *probed_entry = find_entry(path);
+        probed_entry->is_probed = true;
+        probed_entry->probe_timestamp = now;
+        probed_entry->is_attached = is_attached;
+        probed_entry->info = info;
+      }
+
+      if (is_attached) {
+        emit(Event().set_type(Type::attached).set_info(info));
+      }
+    }
+
+    chrono::wait(m_construct.interval());
+  }
+}
+
+#else
+int sos_api_link_monitor_unused;
+#endif
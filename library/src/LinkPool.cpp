@@ -0,0 +1,225 @@
+// Copyright 2016-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#if defined __link
+
+#include <chrono.hpp>
+#include <printer/Printer.hpp>
+
+#include "sos/LinkPool.hpp"
+
+namespace printer {
+Printer &operator<<(Printer &printer, const sos::LinkPool::Result &a) {
+  printer.key_bool("success", a.is_success());
+  if (a.is_success() == false) {
+    printer.key("error", a.error_message())
+      .key("errorNumber", var::NumberString(a.error_number()));
+  }
+  return printer.key(
+    "durationMicroseconds",
+    var::NumberString(a.duration().microseconds()));
+}
+} // namespace printer
+
+using namespace sos;
+
+bool LinkPool::Future::is_ready() const {
+  return is_valid() && m_pool->is_complete(m_device_index, m_id);
+}
+
+LinkPool::Result LinkPool::Future::get() const {
+  if (is_valid() == false) {
+    return Result().set_complete().set_error_number(EINVAL).set_error_message(
+      "invalid future");
+  }
+  return m_pool->wait_result(m_device_index, m_id);
+}
+
+LinkPool::LinkPool(const Construct &options) : m_complete_cond(m_mutex) {
+  m_worker_list.reserve(options.info_list().count());
+  for (const auto &info : options.info_list()) {
+    auto worker = std::make_unique<Worker>(this, m_mutex);
+    worker->info = info;
+    if (options.driver()) {
+      worker->link.set_driver(options.driver());
+    }
+    worker->link.disregard_connection();
+    m_worker_list.push_back(std::move(worker));
+  }
+
+  // workers are started once the list is complete so they can
+  // safely hold a reference to their entry
+  for (auto &worker : m_worker_list) {
+    worker->thread = thread::Thread(
+      thread::Thread::Attributes().set_detach_state(
+        thread::Thread::DetachState::joinable),
+      thread::Thread::Construct().set_argument(worker.get()).set_function(
+        worker_function));
+  }
+}
+
+LinkPool::~LinkPool() {
+  {
+    thread::Mutex::Scope mutex_scope(m_mutex);
+    m_is_stop = true;
+    for (auto &worker : m_worker_list) {
+      worker->cond.broadcast();
+    }
+  }
+
+  // pending jobs are completed before the workers exit
+  for (auto &worker : m_worker_list) {
+    worker->thread.join();
+  }
+}
+
+LinkPool::Future LinkPool::submit(
+  size_t device_index,
+  function_t function,
+  var::View argument,
+  IsAutoConnect is_auto_connect) {
+  API_RETURN_VALUE_IF_ERROR(Future());
+  if (device_index >= m_worker_list.count()) {
+    API_RETURN_VALUE_ASSIGN_ERROR(Future(), "invalid device index", EINVAL);
+  }
+
+  Worker &worker = *m_worker_list.at(device_index);
+
+  Job job;
+  job.function = function;
+  job.is_auto_connect = is_auto_connect;
+  job.argument = var::Data(argument.size());
+  var::View(job.argument).copy(argument);
+
+  thread::Mutex::Scope mutex_scope(m_mutex);
+  const u32 id = worker.next_id++;
+  job.id = id;
+  worker.job_list.push_back(std::move(job));
+  ResultEntry entry;
+  entry.id = id;
+  worker.result_list.push_back(entry);
+  worker.cond.signal();
+  return Future(this, device_index, id);
+}
+
+LinkPool::FutureList
+LinkPool::submit_all(function_t function, var::View argument) {
+  FutureList result;
+  result.reserve(m_worker_list.count());
+  for (size_t i = 0; i < m_worker_list.count(); i++) {
+    result.push_back(submit(i, function, argument));
+  }
+  return result;
+}
+
+LinkPool::ResultList LinkPool::wait(const FutureList &future_list) {
+  ResultList result;
+  result.reserve(future_list.count());
+  for (const auto &future : future_list) {
+    result.push_back(future.get());
+  }
+  return result;
+}
+
+size_t LinkPool::find_result_offset(const Worker &worker, u32 id) {
+  for (size_t i = 0; i < worker.result_list.count(); i++) {
+    if (worker.result_list.at(i).id == id) {
+      return i;
+    }
+  }
+  return worker.result_list.count();
+}
+
+bool LinkPool::is_complete(size_t device_index, u32 id) {
+  thread::Mutex::Scope mutex_scope(m_mutex);
+  const Worker &worker = *m_worker_list.at(device_index);
+  const size_t offset = find_result_offset(worker, id);
+  // a result that was already retrieved won't block get()
+  return offset == worker.result_list.count()
+         || worker.result_list.at(offset).result.is_complete();
+}
+
+LinkPool::Result LinkPool::wait_result(size_t device_index, u32 id) {
+  thread::Mutex::Scope mutex_scope(m_mutex);
+  Worker &worker = *m_worker_list.at(device_index);
+  size_t offset = find_result_offset(worker, id);
+  if (offset == worker.result_list.count()) {
+    return Result().set_complete().set_error_number(ENOENT).set_error_message(
+      "result was already retrieved");
+  }
+
+  while (worker.result_list.at(offset).result.is_complete() == false) {
+    m_complete_cond.wait();
+    // other results may have been released while waiting
+    offset = find_result_offset(worker, id);
+  }
+
+  const Result result = worker.result_list.at(offset).result;
+  worker.result_list.remove(offset);
+  return result;
+}
+
+void *LinkPool::worker_function(void *args) {
+  auto *worker = reinterpret_cast<Worker *>(args);
+  worker->pool->run_worker(*worker);
+  return nullptr;
+}
+
+void LinkPool::run_worker(Worker &worker) {
+  // errors are tracked per thread so these operations
+  // don't affect the thread that created the pool. The link
+  // is connected when the first operation needs it.
+  while (true) {
+    Job job;
+    {
+      thread::Mutex::Scope mutex_scope(m_mutex);
+      while (worker.job_list.count() == 0 && !m_is_stop) {
+        worker.cond.wait();
+      }
+
+      if (worker.job_list.count() == 0) {
+        break;
+      }
+
+      job = std::move(worker.job_list.front());
+      worker.job_list.remove(0);
+    }
+
+    Result result;
+    chrono::ClockTimer timer;
+    timer.start();
+
+    if (
+      job.is_auto_connect == IsAutoConnect::yes && worker.is_auto_connect
+      && worker.link.is_connected() == false) {
+      worker.link.connect(worker.info.path());
+    }
+
+    if (is_success()) {
+      job.function(worker.link, job.argument.data());
+    }
+
+    if (job.is_auto_connect == IsAutoConnect::no) {
+      // an explicit disconnect (or failed connect) isn't undone
+      worker.is_auto_connect = worker.link.is_connected();
+    }
+
+    result.set_duration(timer.micro_time()).set_value(return_value());
+    if (is_error()) {
+      result.set_error_number(error().error_number())
+        .set_error_message(error().message());
+      API_RESET_ERROR();
+    }
+
+    thread::Mutex::Scope mutex_scope(m_mutex);
+    // the entry can't be released until it is complete
+    worker.result_list.at(find_result_offset(worker, job.id)).result
+      = result.set_complete();
+    m_complete_cond.broadcast();
+  }
+
+  worker.link.disconnect();
+}
+
+#else
+int sos_api_link_pool_unused;
+#endif
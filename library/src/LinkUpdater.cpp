@@ -0,0 +1,182 @@
+// Copyright 2016-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#if defined __link
+
+#include <cstring>
+
+#include <chrono.hpp>
+
+#include "sos/LinkUpdater.hpp"
+
+using namespace sos;
+
+LinkPool::ResultList LinkUpdater::update(const Update &options) {
+  API_RETURN_VALUE_IF_ERROR(LinkPool::ResultList());
+
+  // the image is checked once for all the devices
+  const var::View image = options.image();
+  if (image.size() < BOOTLOADER_HARDWARE_ID_OFFSET + sizeof(m_image_id)) {
+    API_RETURN_VALUE_ASSIGN_ERROR(
+      LinkPool::ResultList(),
+      "image is too small",
+      EINVAL);
+  }
+
+  memcpy(
+    &m_image_id,
+    image.to_const_u8() + BOOTLOADER_HARDWARE_ID_OFFSET,
+    sizeof(m_image_id));
+
+  m_update = &options;
+  m_device_list.clear();
+  m_group_list.clear();
+
+  // devices and groups are set up before any worker uses them
+  for (size_t i = 0; i < m_pool->count(); i++) {
+    auto device = std::make_unique<Device>(this);
+    device->device_index = i;
+    if (options.group_function()) {
+      device->group
+        = options.group_function()(m_pool->info(i), options.group_context());
+    }
+    device->printer.set_verbose_level(printer::Printer::Level::fatal);
+    device->progress_callback.set_callback(update_progress)
+      .set_context(device.get());
+    get_group(device->group);
+    m_device_list.push_back(std::move(device));
+  }
+
+  LinkPool::FutureList future_list;
+  future_list.reserve(m_device_list.count());
+  for (auto &device : m_device_list) {
+    const DeviceArgument argument = {device.get()};
+    future_list.push_back(m_pool->submit(
+      device->device_index,
+      update_function,
+      var::View(argument)));
+  }
+
+  const api::ProgressCallback *progress_callback
+    = options.printer() ? options.printer()->progress_callback() : nullptr;
+
+  if (progress_callback) {
+    options.printer()->set_progress_key("updating");
+  }
+
+  bool is_ready = false;
+  while (is_ready == false) {
+    is_ready = true;
+    for (const auto &future : future_list) {
+      if (future.is_ready() == false) {
+        is_ready = false;
+        break;
+      }
+    }
+
+    if (progress_callback) {
+      progress_callback->update(progress(), progress_max());
+    }
+
+    if (is_ready == false) {
+      chrono::wait(options.poll_interval());
+    }
+  }
+
+  if (progress_callback) {
+    progress_callback->update(0, 0);
+  }
+
+  const auto result = LinkPool::wait(future_list);
+  m_update = nullptr;
+  return result;
+}
+
+int LinkUpdater::progress() {
+  thread::Mutex::Scope mutex_scope(m_mutex);
+  int result = 0;
+  for (const auto &device : m_device_list) {
+    result += device->progress;
+  }
+  return result;
+}
+
+int LinkUpdater::progress_max() {
+  thread::Mutex::Scope mutex_scope(m_mutex);
+  int result = 0;
+  for (const auto &device : m_device_list) {
+    result += device->progress_max;
+  }
+  return result;
+}
+
+void LinkUpdater::update_function(Link &link, void *argument) {
+  Device *device = reinterpret_cast<DeviceArgument *>(argument)->device;
+  device->updater->run_update(link, *device);
+}
+
+bool LinkUpdater::update_progress(void *context, int progress, int total) {
+  auto *device = reinterpret_cast<Device *>(context);
+  thread::Mutex::Scope mutex_scope(device->updater->m_mutex);
+  // each phase restarts the progress so only the latest is kept
+  device->progress = progress;
+  device->progress_max = total;
+  return false;
+}
+
+void LinkUpdater::run_update(Link &link, Device &device) {
+  const Update &options = *m_update;
+  const Link::Info &info = m_pool->info(device.device_index);
+
+  // fail early rather than resetting a device the image can't run on
+  if (
+    info.hardware_id() != 0
+    && (info.hardware_id() & ~0x01) != (m_image_id & ~0x01)) {
+    API_RETURN_ASSIGN_ERROR("image id doesn't match the device", EINVAL);
+  }
+
+  {
+    thread::Mutex::Scope mutex_scope(m_mutex);
+    Group &group = get_group(device.group);
+    while (options.group_concurrency()
+           && group.active_count >= options.group_concurrency()) {
+      m_group_cond.wait();
+    }
+    group.active_count++;
+  }
+
+  if (link.is_bootloader() == false) {
+    link.reset_bootloader().reconnect(
+      Link::Reconnect().set_timeout(10_seconds));
+  }
+
+  link.update_os(Link::UpdateOs()
+                   .set_image_view(options.image())
+                   .set_verify(options.is_verify())
+                   .set_verify_interval(options.verify_interval())
+                   .set_chunk_size(options.chunk_size())
+                   .set_bootloader_retry_count(
+                     options.bootloader_retry_count())
+                   .set_printer(&device.printer)
+                   .set_progress_callback(&device.progress_callback));
+
+  thread::Mutex::Scope mutex_scope(m_mutex);
+  get_group(device.group).active_count--;
+  m_group_cond.broadcast();
+}
+
+LinkUpdater::Group &LinkUpdater::get_group(u32 id) {
+  for (auto &group : m_group_list) {
+    if (group.id == id) {
+      return group;
+    }
+  }
+
+  Group group;
+  group.id = id;
+  m_group_list.push_back(group);
+  return m_group_list.back();
+}
+
+#else
+int sos_api_link_updater_unused;
+#endif
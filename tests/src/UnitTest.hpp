@@ -116,6 +116,8 @@ public:
     API_RESET_ERROR();
     device_fs.remove("/app/ram/HelloWorld");
     API_RESET_ERROR();
+    device_fs.remove("/app/flash/HelloRenamed");
+    API_RESET_ERROR();
 
     {
       const StringView hello_world_binary_path
@@ -171,6 +173,80 @@ public:
         TEST_ASSERT(info.ram_size() == ram_size);
         TEST_ASSERT(device_fs.get_info(device_path).is_file());
         printer().object("flashFileInfo", device_fs.get_info(device_path));
+
+        // the same build is already installed
+        File binary_file(hello_world_binary_path);
+        TEST_ASSERT(
+          Appfs(link.driver())
+            .install(Appfs::Install()
+                       .set_file(&binary_file)
+                       .set_printer(&printer()))
+          == Appfs::InstallStatus::skipped);
+
+        // streamed without reading the header
+        TEST_ASSERT(
+          Appfs(link.driver())
+            .install(Appfs::Install()
+                       .set_file(&binary_file.seek(0))
+                       .set_name("HelloWorld")
+                       .set_skip_unchanged(false)
+                       .set_printer(&printer()))
+          == Appfs::InstallStatus::installed);
+        TEST_ASSERT(device_fs.exists(device_path));
+
+        // an app that is not on the device is installed
+        TEST_ASSERT(device_fs.remove(device_path).is_success());
+        TEST_ASSERT(
+          Appfs(link.driver())
+            .install(Appfs::Install()
+                       .set_file(&binary_file.seek(0))
+                       .set_printer(&printer()))
+          == Appfs::InstallStatus::installed);
+        TEST_ASSERT(device_fs.exists(device_path));
+
+        {
+          Appfs::InventoryCache inventory_cache;
+          const auto inventory
+            = Appfs(link.driver()).get_inventory(&inventory_cache);
+          bool is_listed = false;
+          for (const auto &info : inventory) {
+            is_listed = is_listed || info.name() == "HelloWorld";
+          }
+          TEST_ASSERT(is_success());
+          TEST_ASSERT(is_listed);
+          TEST_ASSERT(inventory_cache.hit_count() == 0);
+          // the listing hasn't changed so the cached headers are used
+          TEST_ASSERT(
+            Appfs(link.driver()).get_inventory(&inventory_cache).count()
+            == inventory.count());
+          TEST_ASSERT(inventory_cache.hit_count() == 2);
+
+          // the headers are read again after invalidate()
+          inventory_cache.invalidate();
+          TEST_ASSERT(
+            Appfs(link.driver()).get_inventory(&inventory_cache).count()
+            == inventory.count());
+          TEST_ASSERT(inventory_cache.hit_count() == 2);
+        }
+
+        {
+          // the name replaces the one in the header
+          const StringView renamed_path = "/app/flash/HelloRenamed";
+          const auto install_renamed = [&]() {
+            return Appfs(link.driver())
+              .install(Appfs::Install()
+                         .set_file(&binary_file.seek(0))
+                         .set_name("HelloRenamed")
+                         .set_printer(&printer()));
+          };
+          TEST_ASSERT(install_renamed() == Appfs::InstallStatus::installed);
+          TEST_ASSERT(device_fs.exists(renamed_path));
+          TEST_ASSERT(
+            Appfs(link.driver()).get_info(renamed_path).name()
+            == "HelloRenamed");
+          TEST_ASSERT(install_renamed() == Appfs::InstallStatus::skipped);
+          TEST_ASSERT(device_fs.remove(renamed_path).is_success());
+        }
         TEST_ASSERT(device_fs.remove(device_path).is_success());
       }
 
@@ -197,6 +273,29 @@ public:
         TEST_ASSERT(device_fs.get_info(device_path).is_file());
       }
 
+      {
+        // a failed append leaves a partial app that can't be continued
+        Appfs appfs(
+          Appfs::Construct()
+            .set_name("HelloWorld")
+            .set_size(File(hello_world_binary_path).size()),
+          link.driver());
+        TEST_ASSERT(appfs
+                      .append(File(
+                        File::IsOverwrite::yes,
+                        "tmp_appfs_abort.dat",
+                        OpenMode::write_only()))
+                      .is_error());
+        API_RESET_ERROR();
+        TEST_ASSERT(appfs.is_append_ready() == false);
+        TEST_ASSERT(appfs.append(File(hello_world_binary_path)).is_error());
+        TEST_ASSERT(error().error_number() == EINVAL);
+        API_RESET_ERROR();
+        TEST_ASSERT(FileSystem().remove("tmp_appfs_abort.dat").is_success());
+        device_fs.remove("/app/flash/HelloWorld");
+        API_RESET_ERROR();
+      }
+
       TEST_ASSERT(Appfs(link.driver()).is_flash_available());
       TEST_ASSERT(Appfs(link.driver()).is_ram_available());
 
@@ -224,9 +323,183 @@ public:
 
   bool link_case() {
     TEST_ASSERT(link_connect_case());
+    TEST_ASSERT(link_info_cache_case());
+    TEST_ASSERT(link_pool_case());
+    TEST_ASSERT(link_monitor_case());
     TEST_ASSERT(link_path_case());
     TEST_ASSERT(link_driver_path_case());
     TEST_ASSERT(link_os_case());
+    TEST_ASSERT(link_os_flash_device_case());
+    TEST_ASSERT(link_updater_case());
+    return true;
+  }
+
+  bool link_info_cache_case() {
+    const StringView cache_path = "tmp_link_info_cache.dat";
+    SerialNumber serial_number;
+
+    {
+      Link::InfoCache info_cache(cache_path);
+      Link link;
+      usb_link_transport_load_driver(link.driver());
+      link.set_info_cache(&info_cache);
+
+      auto list = link.get_info_list();
+      TEST_ASSERT(list.count() > 0);
+      serial_number = list.front().serial_number();
+      TEST_ASSERT(info_cache.find(serial_number).is_valid());
+    }
+
+    {
+      Link::InfoCache info_cache(cache_path);
+      TEST_ASSERT(info_cache.find(serial_number).is_valid());
+
+      Link link;
+      usb_link_transport_load_driver(link.driver());
+      link.set_info_cache(&info_cache);
+      TEST_ASSERT(link.connect(serial_number).is_success());
+      TEST_ASSERT(link.info().serial_number() == serial_number);
+      TEST_ASSERT(
+        link.info().path()
+        == info_cache.find(serial_number).info().path());
+    }
+
+    u64 erase_microseconds = 0;
+    {
+      // erase_os() records how long the erase took for the next update
+      Link::InfoCache info_cache(cache_path);
+      Link link;
+      usb_link_transport_load_driver(link.driver());
+      link.set_info_cache(&info_cache);
+      TEST_ASSERT(link.connect(serial_number).is_success());
+      if (link.is_bootloader() == false) {
+        TEST_ASSERT(
+          link.reset_bootloader().reconnect(10, 200_milliseconds).is_bootloader()
+          == true);
+      }
+
+      const Link::MappedImage image("../tests/Nucleo-F446ZE.bin");
+      TEST_ASSERT(link(Link::UpdateOs()
+                         .set_image_view(image.view())
+                         .set_printer(&printer()))
+                    .is_success());
+      erase_microseconds = link.update_report().erase_duration().microseconds();
+      TEST_ASSERT(erase_microseconds > 0);
+      TEST_ASSERT(
+        info_cache.find(serial_number).erase_duration().microseconds()
+        == erase_microseconds);
+      TEST_ASSERT(link.reset().reconnect(10, 200_milliseconds).is_success());
+    }
+
+    {
+      // the cache file keeps the erase duration in milliseconds
+      Link::InfoCache info_cache(cache_path);
+      TEST_ASSERT(
+        info_cache.find(serial_number).erase_duration().microseconds()
+        == erase_microseconds / 1000 * 1000);
+    }
+
+    FileSystem().remove(cache_path);
+    return true;
+  }
+
+  bool link_pool_case() {
+    Link link;
+    usb_link_transport_load_driver(link.driver());
+
+    const auto list = link.get_info_list();
+    TEST_ASSERT(list.count() > 0);
+
+    LinkPool pool(
+      LinkPool::Construct().set_info_list(list).set_driver(link.driver()));
+    TEST_ASSERT(pool.count() == list.count());
+
+    const auto result_list = LinkPool::wait(pool.submit_all(
+      [](Link &link, void *) {
+        struct tm time_value = {};
+        link.get_time(&time_value);
+      }));
+
+    TEST_ASSERT(result_list.count() == list.count());
+    for (const auto &result : result_list) {
+      printer().object("result", result);
+      TEST_ASSERT(result.is_complete());
+      TEST_ASSERT(result.is_success());
+    }
+
+    {
+      // a result is released once it has been retrieved
+      const auto future = pool.submit(0, [](Link &, void *) {});
+      TEST_ASSERT(future.get().is_success());
+      TEST_ASSERT(future.is_ready());
+      TEST_ASSERT(future.get().error_number() == ENOENT);
+    }
+
+    {
+      LinkAsync link_async(pool, 0);
+      var::String long_path("/home/");
+      while (long_path.length() < LINK_PATH_MAX) {
+        long_path += "a";
+      }
+      {
+        api::ErrorScope error_scope;
+        TEST_ASSERT(link_async.run_app(long_path).is_valid() == false);
+        TEST_ASSERT(error().error_number() == ENAMETOOLONG);
+      }
+
+      // an explicit disconnect isn't undone by the next operation
+      struct tm time_value = {};
+      TEST_ASSERT(link_async.disconnect().get().is_success());
+      TEST_ASSERT(link_async.get_time(&time_value).get().is_success() == false);
+      TEST_ASSERT(link_async.connect(list.front().path()).get().is_success());
+      TEST_ASSERT(link_async.get_time(&time_value).get().is_success());
+    }
+
+    return true;
+  }
+
+  bool link_monitor_case() {
+    {
+      fs::PathList previous;
+      previous.push_back("usb/20a0/41d5/00/A");
+      previous.push_back("usb/20a0/41d5/00/B");
+      fs::PathList current;
+      current.push_back("usb/20a0/41d5/00/B");
+      current.push_back("usb/20a0/41d5/00/C");
+
+      const auto path_diff = LinkMonitor::get_path_diff(previous, current);
+      TEST_ASSERT(path_diff.added_list().count() == 1);
+      TEST_ASSERT(path_diff.added_list().front() == "usb/20a0/41d5/00/C");
+      TEST_ASSERT(path_diff.removed_list().count() == 1);
+      TEST_ASSERT(path_diff.removed_list().front() == "usb/20a0/41d5/00/A");
+
+      const auto same_diff = LinkMonitor::get_path_diff(current, current);
+      TEST_ASSERT(same_diff.added_list().count() == 0);
+      TEST_ASSERT(same_diff.removed_list().count() == 0);
+
+      const auto empty_diff = LinkMonitor::get_path_diff(previous, {});
+      TEST_ASSERT(empty_diff.added_list().count() == 0);
+      TEST_ASSERT(empty_diff.removed_list().count() == previous.count());
+    }
+
+    {
+      Link link;
+      usb_link_transport_load_driver(link.driver());
+      const auto list = link.get_info_list();
+      TEST_ASSERT(list.count() > 0);
+
+      // the connected devices are reported as attached
+      LinkMonitor monitor(
+        LinkMonitor::Construct().set_driver(link.driver()).set_interval(
+          50_milliseconds));
+      for (size_t i = 0; i < list.count(); i++) {
+        const auto event = monitor.wait_event();
+        TEST_ASSERT(event.is_attached());
+      }
+      TEST_ASSERT(monitor.get_info_list().count() == list.count());
+      TEST_ASSERT(monitor.dropped_event_count() == 0);
+    }
+
     return true;
   }
 
@@ -248,14 +521,290 @@ public:
     const StringView binary_path = "../tests/Nucleo-F446ZE.bin";
     TEST_ASSERT(FileSystem().exists(binary_path));
 
+    const StringView image_store_path = "tmp_image_store.dat";
+    ImageStore image_store(image_store_path);
+    const auto entry = image_store.get(binary_path);
+    TEST_ASSERT(entry.is_valid());
+    TEST_ASSERT(entry.size() == File(binary_path).size());
+    TEST_ASSERT(entry.signature_info().size() <= entry.size());
+    TEST_ASSERT(image_store.find(entry.hash()).size() == entry.size());
+    TEST_ASSERT(image_store.save().is_success());
+    // a second store loads the entry without hashing the image
+    TEST_ASSERT(ImageStore(image_store_path).find(entry.hash()).is_valid());
+
     File image(binary_path);
-    TEST_ASSERT(link(Link::UpdateOs().set_image(&image).set_printer(&printer()))
+    TEST_ASSERT(link(Link::UpdateOs()
+                       .set_image(&image)
+                       .set_image_hash(var::View(entry.hash()))
+                       .set_image_store(&image_store)
+                       .set_printer(&printer()))
                   .is_success());
+    FileSystem().remove(image_store_path);
+
+    // install again from a mapped image with larger chunks
+    const Link::MappedImage mapped_image(binary_path);
+    TEST_ASSERT(mapped_image.view().size() == image.size());
+    TEST_ASSERT(
+      link.reset_bootloader().reconnect(10, 200_milliseconds).is_bootloader()
+      == true);
+    TEST_ASSERT(link(Link::UpdateOs()
+                       .set_image_view(mapped_image.view())
+                       .set_chunk_size(4096)
+                       .set_adaptive_chunk_size()
+                       .set_sparse()
+                       .set_verify()
+                       .set_verify_interval(8)
+                       .set_printer(&printer()))
+                  .is_success());
+    TEST_ASSERT(link.update_report().chunk_size() >= 4096);
+
+    // chunk sizes are rounded down to a multiple of the minimum and capped
+    for (const u32 chunk_size : {3000U, 4U * Link::UpdateOs::maximum_chunk_size}) {
+      const u32 expected_chunk_size
+        = chunk_size > Link::UpdateOs::maximum_chunk_size
+            ? u32(Link::UpdateOs::maximum_chunk_size)
+            : chunk_size - chunk_size % Link::UpdateOs::minimum_chunk_size;
+      const u32 expected_write_count
+        = (mapped_image.view().size() + expected_chunk_size - 1)
+          / expected_chunk_size;
+
+      TEST_ASSERT(
+        link.reset_bootloader().reconnect(10, 200_milliseconds).is_bootloader()
+        == true);
+      TEST_ASSERT(link(Link::UpdateOs()
+                         .set_image_view(mapped_image.view())
+                         .set_chunk_size(chunk_size)
+                         .set_printer(&printer()))
+                    .is_success());
+      TEST_ASSERT(link.update_report().chunk_size() == expected_chunk_size);
+      // older bootloaders write the start page again at the end
+      TEST_ASSERT(link.update_report().write_count() >= expected_write_count);
+      TEST_ASSERT(
+        link.update_report().write_count() <= expected_write_count + 1);
+    }
+
+    {
+      // stop an install halfway then resume it from the journal
+      const StringView journal_path = "tmp_link_os_journal.dat";
+      if (FileSystem().exists(journal_path)) {
+        FileSystem().remove(journal_path);
+      }
+
+      u32 image_size = mapped_image.view().size();
+      api::ProgressCallback abort_callback;
+      abort_callback
+        .set_callback([](void *context, int progress, int total) -> bool {
+          // the install reports progress out of the image size
+          const int image_size = int(*reinterpret_cast<u32 *>(context));
+          return total == image_size && progress >= image_size / 2;
+        })
+        .set_context(&image_size);
+
+      TEST_ASSERT(
+        link.reset_bootloader().reconnect(10, 200_milliseconds).is_bootloader()
+        == true);
+      link(Link::UpdateOs()
+             .set_image_view(mapped_image.view())
+             .set_journal_path(journal_path)
+             .set_progress_callback(&abort_callback)
+             .set_printer(&printer()));
+      API_RESET_ERROR();
+      TEST_ASSERT(FileSystem().exists(journal_path));
+
+      TEST_ASSERT(link(Link::UpdateOs()
+                         .set_image_view(mapped_image.view())
+                         .set_journal_path(journal_path)
+                         .set_printer(&printer()))
+                    .is_success());
+
+      bootloader_attr_t attr;
+      TEST_ASSERT(link.get_bootloader_attr(attr).is_success());
+      // newer bootloaders lose the start page so they start over
+      if (attr.version < 0x400 && link.is_signature_required() == false) {
+        TEST_ASSERT(link.update_report().resume_offset() > 0);
+        TEST_ASSERT(
+          link.update_report().erase_duration().microseconds() == 0);
+      }
+      TEST_ASSERT(FileSystem().exists(journal_path) == false);
+
+      TEST_ASSERT(link(Link::CompareFlash()
+                         .set_image_view(mapped_image.view())
+                         .set_printer(&printer()))
+                    .is_success());
+      TEST_ASSERT(
+        link.compare_report().compared_page_count()
+        == link.compare_report().page_count());
+      TEST_ASSERT(link.compare_report().mismatch_list().count() == 0);
+    }
+
+    // the image is already installed so this doesn't erase or write the flash
+    TEST_ASSERT(link(Link::UpdateOs()
+                       .set_image_view(mapped_image.view())
+                       .set_delta()
+                       .set_printer(&printer()))
+                  .is_success());
+    TEST_ASSERT(link.update_report().write_count() == 0);
+    TEST_ASSERT(link.update_report().erase_duration().microseconds() == 0);
+
+    if (link.is_signature_required() == false) {
+      // clearing bits in one page only rewrites that page
+      const u32 image_size = mapped_image.view().size();
+      var::Data changed_image(image_size);
+      var::View(changed_image).copy(mapped_image.view());
+      u8 *changed_data = var::View(changed_image).to_u8();
+      u32 offset = image_size / 2;
+      while (offset < image_size && changed_data[offset] == 0) {
+        offset++;
+      }
+      TEST_ASSERT(offset < image_size);
+      changed_data[offset] = 0;
+
+      TEST_ASSERT(link(Link::UpdateOs()
+                         .set_image_view(var::View(changed_image))
+                         .set_delta()
+                         .set_printer(&printer()))
+                    .is_success());
+      TEST_ASSERT(link.update_report().write_count() == 1);
+      TEST_ASSERT(link.update_report().erase_duration().microseconds() == 0);
+      TEST_ASSERT(link(Link::CompareFlash()
+                         .set_image_view(var::View(changed_image))
+                         .set_printer(&printer()))
+                    .is_success());
+      TEST_ASSERT(link.compare_report().is_match());
+
+      // setting the bits again needs the OS to be erased
+      TEST_ASSERT(link(Link::UpdateOs()
+                         .set_image_view(mapped_image.view())
+                         .set_delta()
+                         .set_printer(&printer()))
+                    .is_success());
+      TEST_ASSERT(link.update_report().erase_duration().microseconds() > 0);
+    }
+
+    {
+      bootloader_attr_t attr;
+      TEST_ASSERT(link.get_bootloader_attr(attr).is_success());
+      DataFile dump_file;
+      DataFile manifest_file;
+      TEST_ASSERT(link(Link::DumpFlash()
+                         .set_address(attr.startaddr)
+                         .set_size(mapped_image.view().size())
+                         .set_file(&dump_file)
+                         .set_manifest(&manifest_file)
+                         .set_printer(&printer()))
+                    .is_success());
+      TEST_ASSERT(dump_file.data().size() == mapped_image.view().size());
+      TEST_ASSERT(manifest_file.data().size() > 0);
+    }
+
+    TEST_ASSERT(link(Link::CompareFlash()
+                       .set_image_view(mapped_image.view())
+                       .set_sample_interval(16)
+                       .set_printer(&printer()))
+                  .is_success());
+    TEST_ASSERT(link.compare_report().is_match());
+    TEST_ASSERT(link(Link::CompareFlash()
+                       .set_image_view(mapped_image.view())
+                       .set_printer(&printer()))
+                  .is_success());
+    TEST_ASSERT(link.compare_report().is_strict());
+    TEST_ASSERT(
+      link.compare_report().compared_page_count()
+      == link.compare_report().page_count());
+    TEST_ASSERT(link.compare_report().is_match());
+
     TEST_ASSERT(link.reset().reconnect().is_success());
     printer().object("info", link.info());
     return true;
   }
 
+  bool link_os_flash_device_case() {
+    Link link;
+    usb_link_transport_load_driver(link.driver());
+
+    auto list = link.get_info_list();
+    TEST_ASSERT(list.count() > 0);
+    TEST_ASSERT(link.connect(list.front().path()).is_success());
+
+    // only a bootloader that runs Stratify OS has the OS flash device
+    const StringView flash_path = "/dev/flash0";
+    if (
+      link.is_bootloader()
+      || Link::FileSystem(link.driver()).exists(flash_path) == false) {
+      printer().key("flashDevice", "skipped");
+      return true;
+    }
+
+    const Link::MappedImage image("../tests/Nucleo-F446ZE.bin");
+    TEST_ASSERT(image.view().size() > 0);
+
+    TEST_ASSERT(link(Link::UpdateOs()
+                       .set_image_view(image.view())
+                       .set_flash_path(flash_path)
+                       .set_printer(&printer()))
+                  .is_success());
+    {
+      // each chunk of the image is either written or skipped as erased
+      const auto &report = link.update_report();
+      TEST_ASSERT(report.erase_duration().microseconds() > 0);
+      TEST_ASSERT(report.write_count() > 0);
+      TEST_ASSERT(report.skipped_size() < image.view().size());
+      TEST_ASSERT(
+        report.write_count() * report.chunk_size() + report.skipped_size()
+        >= image.view().size() - sizeof(auth_signature_marker_t));
+    }
+
+    // delta is ignored when the flash requires a signature
+    const bool is_signature_required
+      = Link::File(flash_path, OpenMode::read_only(), link.driver())
+          .ioctl(I_FLASH_IS_SIGNATURE_REQUIRED)
+          .return_value()
+        == 1;
+    API_RESET_ERROR();
+
+    if (is_signature_required == false) {
+      // the same image again doesn't erase or write any pages
+      TEST_ASSERT(link(Link::UpdateOs()
+                         .set_image_view(image.view())
+                         .set_flash_path(flash_path)
+                         .set_delta()
+                         .set_printer(&printer()))
+                    .is_success());
+      TEST_ASSERT(link.update_report().erase_duration().microseconds() == 0);
+      TEST_ASSERT(link.update_report().write_count() == 0);
+    }
+    return true;
+  }
+
+  bool link_updater_case() {
+    Link link;
+    usb_link_transport_load_driver(link.driver());
+
+    const auto list = link.get_info_list();
+    TEST_ASSERT(list.count() > 0);
+
+    const Link::MappedImage image("../tests/Nucleo-F446ZE.bin");
+    TEST_ASSERT(image.view().size() > 0);
+
+    LinkPool pool(
+      LinkPool::Construct().set_info_list(list).set_driver(link.driver()));
+    const auto result_list = LinkUpdater(pool).update(
+      LinkUpdater::Update()
+        .set_image(image.view())
+        .set_group_concurrency(2)
+        .set_printer(&printer()));
+
+    TEST_ASSERT(result_list.count() == list.count());
+    for (const auto &result : result_list) {
+      printer().object("result", result);
+      TEST_ASSERT(result.is_success());
+    }
+
+    LinkPool::wait(
+      pool.submit_all([](Link &link, void *) { link.reset().reconnect(); }));
+    return true;
+  }
+
   bool link_connect_case() {
 
     Link link;
@@ -275,6 +824,13 @@ public:
     TEST_ASSERT(is_success());
 
     printer().array("list", list);
+    {
+      const auto parallel_list
+        = link.get_info_list(Link::GetInfoList().set_thread_count(4));
+      TEST_ASSERT(parallel_list.count() == list.count());
+      TEST_ASSERT(parallel_list.front().path() == list.front().path());
+    }
+
     for (const auto &device : list) {
       TEST_ASSERT(link.connect(device.path()).is_success());
 
@@ -286,6 +842,7 @@ public:
 
     TEST_ASSERT(link.reconnect(10, 200_milliseconds).is_success());
     printer().object("info", link.info());
+    printer().object("reconnect", link.reconnect_report());
     TEST_ASSERT(
       list.front().serial_number().to_string()
       == link.info().serial_number().to_string());